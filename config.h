@@ -4,15 +4,15 @@ struct settings defaults = {
 
 .font = "-*-terminus-medium-r-*-*-16-*-*-*-*-*-*-*",
 .markup = MARKUP_NO,
-.colors_norm.bg = "#1793D1",
-.colors_norm.fg = "#DDDDDD",
-.colors_norm.highlight = "#1745d1",
-.colors_crit.bg = "#ffaaaa",
-.colors_crit.fg = "#000000",
-.colors_crit.highlight = "#ff6666",
-.colors_low.bg = "#aaaaff",
-.colors_low.fg = "#000000",
-.colors_low.highlight = "#7f7fff",
+.colors_norm.bg = 0x1793D1FF,
+.colors_norm.fg = 0xDDDDDDFF,
+.colors_norm.highlight = 0x1745D1FF,
+.colors_crit.bg = 0xFFAAAAFF,
+.colors_crit.fg = 0x000000FF,
+.colors_crit.highlight = 0xFF6666FF,
+.colors_low.bg = 0xAAAAFFFF,
+.colors_low.fg = 0x000000FF,
+.colors_low.highlight = 0x7F7FFFFF,
 .format = "%s %b",         /* default format */
 
 .timeouts = { S2US(10), S2US(10), S2US(0) }, /* low, normal, critical */
@@ -66,6 +66,9 @@ struct settings defaults = {
  * */
 .startup_notification = false,
 
+/* maximum amount of redraws per second, 0 for unlimited */
+.max_redraw_rate = 60,
+
 /* monitor to display notifications on */
 .monitor = 0,
 
@@ -80,6 +83,12 @@ struct settings defaults = {
 /* paths to default icons */
 .icon_path = "/usr/share/icons/gnome/16x16/status/:/usr/share/icons/gnome/16x16/devices/",
 
+/* icon theme to look up icons in, empty to only use icon_path */
+.icon_theme = "",
+
+/* memory for decoded icons in kilobytes */
+.icon_cache_size = 4096,
+
 
 /* follow focus to different monitor and display notifications there?
  * possible values:
@@ -152,8 +161,7 @@ struct rule default_rules[] = {
                 .set_transient   = -1,
                 .skip_display    = -1,
                 .new_icon        = NULL,
-                .fg              = NULL,
-                .bg              = NULL,
+                .colors.set      = 0,
                 .format          = NULL,
                 .script          = NULL,
         }
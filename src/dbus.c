@@ -7,10 +7,13 @@
 #include <stdlib.h>
 
 #include "dunst.h"
+#include "icon.h"
 #include "log.h"
 #include "menu.h"
 #include "notification.h"
+#include "option_parser.h"
 #include "queues.h"
+#include "rules.h"
 #include "settings.h"
 #include "utils.h"
 
@@ -80,6 +83,9 @@ static const char *introspection_xml =
     "        <method name=\"NotificationCloseAll\"  />"
     "        <method name=\"NotificationShow\"      />"
     "        <method name=\"Ping\"                  />"
+    "        <method name=\"RuleStats\">"
+    "            <arg direction=\"out\" name=\"stats\"     type=\"a(stttt)\"/>"
+    "        </method>"
 
     "        <property name=\"paused\" type=\"b\" access=\"readwrite\">"
     "            <annotation name=\"org.freedesktop.DBus.Property.EmitsChangedSignal\" value=\"true\"/>"
@@ -88,6 +94,12 @@ static const char *introspection_xml =
     "        <property name=\"displayedLength\" type=\"u\" access=\"read\" />"
     "        <property name=\"historyLength\" type=\"u\" access=\"read\" />"
     "        <property name=\"waitingLength\" type=\"u\" access=\"read\" />"
+    "        <property name=\"redrawsRequested\" type=\"t\" access=\"read\" />"
+    "        <property name=\"redrawsPerformed\" type=\"t\" access=\"read\" />"
+    "        <property name=\"iconCacheHits\" type=\"t\" access=\"read\" />"
+    "        <property name=\"iconCacheMisses\" type=\"t\" access=\"read\" />"
+    "        <property name=\"ruleCacheHits\" type=\"t\" access=\"read\" />"
+    "        <property name=\"ruleCacheMisses\" type=\"t\" access=\"read\" />"
 
     "    </interface>"
     "</node>";
@@ -163,6 +175,7 @@ DBUS_METHOD(dunst_NotificationCloseAll);
 DBUS_METHOD(dunst_NotificationCloseLast);
 DBUS_METHOD(dunst_NotificationShow);
 DBUS_METHOD(dunst_Ping);
+DBUS_METHOD(dunst_RuleStats);
 static struct dbus_method methods_dunst[] = {
         {"ContextMenuCall",        dbus_cb_dunst_ContextMenuCall},
         {"NotificationAction",     dbus_cb_dunst_NotificationAction},
@@ -170,6 +183,7 @@ static struct dbus_method methods_dunst[] = {
         {"NotificationCloseLast",  dbus_cb_dunst_NotificationCloseLast},
         {"NotificationShow",       dbus_cb_dunst_NotificationShow},
         {"Ping",                   dbus_cb_dunst_Ping},
+        {"RuleStats",              dbus_cb_dunst_RuleStats},
 };
 
 void dbus_cb_dunst_methods(GDBusConnection *connection,
@@ -293,6 +307,31 @@ static void dbus_cb_dunst_Ping(GDBusConnection *connection,
         g_dbus_connection_flush(connection, NULL, NULL, NULL);
 }
 
+/* Return the counters of every rule in the order of the dunstrc:
+ * name, checks, matches, applies and the evaluation time in nanoseconds */
+static void dbus_cb_dunst_RuleStats(GDBusConnection *connection,
+                                    const gchar *sender,
+                                    GVariant *parameters,
+                                    GDBusMethodInvocation *invocation)
+{
+        GVariantBuilder builder;
+        g_variant_builder_init(&builder, G_VARIANT_TYPE("a(stttt)"));
+
+        for (GSList *iter = rules; iter; iter = iter->next) {
+                struct rule *r = iter->data;
+                g_variant_builder_add(&builder,
+                                      "(stttt)",
+                                      r->name ? r->name : "",
+                                      r->stats.checks,
+                                      r->stats.matches,
+                                      r->stats.applies,
+                                      r->stats.eval_time);
+        }
+
+        g_dbus_method_invocation_return_value(invocation, g_variant_new("(a(stttt))", &builder));
+        g_dbus_connection_flush(connection, NULL, NULL, NULL);
+}
+
 
 static void dbus_cb_GetCapabilities(
                 GDBusConnection *connection,
@@ -321,6 +360,27 @@ static void dbus_cb_GetCapabilities(
         g_dbus_connection_flush(connection, NULL, NULL, NULL);
 }
 
+/**
+ * Parse a color sent as hint. Invalid colors get ignored.
+ *
+ * @param hint The string value of the hint
+ * @param colors The colors of the notification
+ * @param color The field in colors to set
+ * @param field The #color_field flag of color
+ */
+static void dbus_parse_color_hint(GVariant *hint,
+                                  struct notification_colors *colors,
+                                  uint32_t *color,
+                                  enum color_field field)
+{
+        const char *str = g_variant_get_string(hint, NULL);
+
+        if (string_parse_color(str, color))
+                colors->set |= field;
+        else
+                LOG_W("Invalid color hint: '%s'", str);
+}
+
 static struct notification *dbus_message_to_notification(const gchar *sender, GVariant *parameters)
 {
         /* Assert that the parameters' type is actually correct. Albeit usually DBus
@@ -371,17 +431,17 @@ static struct notification *dbus_message_to_notification(const gchar *sender, GV
         }
 
         if ((dict_value = g_variant_lookup_value(hints, "fgcolor", G_VARIANT_TYPE_STRING))) {
-                n->colors.fg = g_variant_dup_string(dict_value, NULL);
+                dbus_parse_color_hint(dict_value, &n->colors, &n->colors.fg, COLOR_FG);
                 g_variant_unref(dict_value);
         }
 
         if ((dict_value = g_variant_lookup_value(hints, "bgcolor", G_VARIANT_TYPE_STRING))) {
-                n->colors.bg = g_variant_dup_string(dict_value, NULL);
+                dbus_parse_color_hint(dict_value, &n->colors, &n->colors.bg, COLOR_BG);
                 g_variant_unref(dict_value);
         }
 
         if ((dict_value = g_variant_lookup_value(hints, "frcolor", G_VARIANT_TYPE_STRING))) {
-                n->colors.frame = g_variant_dup_string(dict_value, NULL);
+                dbus_parse_color_hint(dict_value, &n->colors, &n->colors.frame, COLOR_FRAME);
                 g_variant_unref(dict_value);
         }
 
@@ -631,6 +691,18 @@ GVariant *dbus_cb_dunst_Properties_Get(GDBusConnection *connection,
         } else if (STR_EQ(property_name, "waitingLength")) {
                 unsigned int waiting =  queues_length_waiting();
                 return g_variant_new_uint32(waiting);
+        } else if (STR_EQ(property_name, "redrawsRequested")) {
+                return g_variant_new_uint64(dunst_redraw_stats_get().requested);
+        } else if (STR_EQ(property_name, "redrawsPerformed")) {
+                return g_variant_new_uint64(dunst_redraw_stats_get().performed);
+        } else if (STR_EQ(property_name, "iconCacheHits")) {
+                return g_variant_new_uint64(icon_cache_stats_get().hits);
+        } else if (STR_EQ(property_name, "iconCacheMisses")) {
+                return g_variant_new_uint64(icon_cache_stats_get().misses);
+        } else if (STR_EQ(property_name, "ruleCacheHits")) {
+                return g_variant_new_uint64(rule_cache_stats_get().hits);
+        } else if (STR_EQ(property_name, "ruleCacheMisses")) {
+                return g_variant_new_uint64(rule_cache_stats_get().misses);
         } else {
                 LOG_W("Unknown property!\n");
                 *error = g_error_new(G_DBUS_ERROR, G_DBUS_ERROR_UNKNOWN_PROPERTY, "Unknown property");
@@ -19,6 +19,7 @@
 #include "queues.h"
 #include "output.h"
 #include "settings.h"
+#include "utils.h"
 
 struct color {
         double r;
@@ -27,6 +28,18 @@ struct color {
         double a;
 };
 
+//!< The inputs of a rendered layout, which don't belong to the layout itself
+struct layout_render_state {
+        int y;                  //!< the top of the area of the layout in #back_buffer
+        int height;             //!< the height of the area of the layout in #back_buffer
+        int width;
+        int corner_radius;
+        bool first;
+        bool last;
+        int progress;
+        struct color sep_color; //!< the color of the separator below the layout
+};
+
 struct colored_layout {
         PangoLayout *l;
         struct color fg;
@@ -37,6 +50,17 @@ struct colored_layout {
         PangoAttrList *attr;
         cairo_surface_t *icon;
         const struct notification *n;
+
+        /* Inputs of the cached layouts of displayed notifications */
+        bool cached;             /**< the layout is owned by #layout_cache */
+        char *markup;            /**< the text_to_render, which got parsed into text and attr */
+        const cairo_surface_t *icon_src; /**< the icon of the notification, when the layout got updated */
+        int dpi;                 /**< the resolution, the layout got created with */
+        unsigned int generation; /**< the draw pass, which used the layout last */
+
+        /* Damage tracking of the layouts in #back_buffer */
+        bool damaged;            /**< the layout changed since it got rendered into #back_buffer */
+        struct layout_render_state rendered; /**< the state of the layout in #back_buffer */
 };
 
 const struct output *output;
@@ -44,6 +68,17 @@ window win;
 
 PangoFontDescription *pango_fdesc;
 
+/** The context all layouts get created with */
+static PangoContext *layout_context = NULL;
+
+/** The layouts of the displayed notifications: struct notification* -> struct colored_layout* */
+static GHashTable *layout_cache = NULL;
+/** Counter of the draw passes to detect unused entries in #layout_cache */
+static unsigned int draw_generation = 0;
+
+/** The image of the last draw pass. Only the areas of changed layouts get rendered again. */
+static cairo_surface_t *back_buffer = NULL;
+
 #define UINT_MAX_N(bits) ((1 << bits) - 1)
 
 void draw_setup(void)
@@ -56,6 +91,31 @@ void draw_setup(void)
         pango_fdesc = pango_font_description_from_string(settings.font);
 }
 
+static void free_colored_layout(void *data);
+
+/**
+ * Get the cache for the layouts of the displayed notifications
+ */
+static GHashTable *layout_cache_get(void)
+{
+        if (!layout_cache)
+                layout_cache = g_hash_table_new_full(g_direct_hash,
+                                                     g_direct_equal,
+                                                     (GDestroyNotify) notification_unref,
+                                                     free_colored_layout);
+        return layout_cache;
+}
+
+/**
+ * Check if a cached layout has not been used by the current draw pass.
+ * Matches the signature of GHRFunc.
+ */
+static gboolean layout_cache_is_stale(gpointer key, gpointer value, gpointer user_data)
+{
+        struct colored_layout *cl = value;
+        return cl->generation != draw_generation;
+}
+
 static struct color hex_to_color(uint32_t hexValue, int dpc)
 {
         const int bpc = 4 * dpc;
@@ -70,24 +130,12 @@ static struct color hex_to_color(uint32_t hexValue, int dpc)
         return ret;
 }
 
-static struct color string_to_color(const char *str)
+/**
+ * Unpack a color parsed by string_parse_color()
+ */
+static inline struct color rgba_to_color(uint32_t rgba)
 {
-        char *end;
-        uint_fast32_t val = strtoul(str+1, &end, 16);
-        if (end[0] != '\0' && end[1] != '\0') {
-                LOG_W("Invalid color string: '%s'", str);
-        }
-
-        switch (end - (str+1)) {
-                case 3:  return hex_to_color((val << 4) | 0xF, 1);
-                case 6:  return hex_to_color((val << 8) | 0xFF, 2);
-                case 4:  return hex_to_color(val, 1);
-                case 8:  return hex_to_color(val, 2);
-        }
-
-        /* return black on error */
-        LOG_W("Invalid color string: '%s'", str);
-        return hex_to_color(0xF, 1);
+        return hex_to_color(rgba, 2);
 }
 
 static inline double color_apply_delta(double base, double delta)
@@ -128,7 +176,7 @@ static struct color layout_get_sepcolor(struct colored_layout *cl,
                 else
                         return cl->frame;
         case SEP_CUSTOM:
-                return string_to_color(settings.sep_color.sep_color);
+                return rgba_to_color(settings.sep_color.sep_color);
         case SEP_FOREGROUND:
                 return cl->fg;
         case SEP_AUTO:
@@ -169,6 +217,7 @@ static void free_colored_layout(void *data)
         g_object_unref(cl->l);
         pango_attr_list_unref(cl->attr);
         g_free(cl->text);
+        g_free(cl->markup);
         if (cl->icon) cairo_surface_destroy(cl->icon);
         g_free(cl);
 }
@@ -281,24 +330,74 @@ static struct dimensions calculate_dimensions(GSList *layouts)
         return dim;
 }
 
-static PangoLayout *layout_create(cairo_t *c)
+/**
+ * Get the PangoContext to create layouts with.
+ *
+ * The context gets created once from the window's cairo context and is
+ * only updated, when the resolution of the active screen changes.
+ */
+static PangoContext *layout_context_get(void)
 {
         const struct screen_info *screen = output->get_active_screen();
 
-        PangoContext *context = pango_cairo_create_context(c);
-        pango_cairo_context_set_resolution(context, screen->dpi);
+        if (!layout_context) {
+                layout_context = pango_cairo_create_context(output->win_get_context(win));
+                pango_cairo_context_set_resolution(layout_context, screen->dpi);
+        } else if (pango_cairo_context_get_resolution(layout_context) != screen->dpi) {
+                pango_cairo_context_set_resolution(layout_context, screen->dpi);
+        }
 
-        PangoLayout *layout = pango_layout_new(context);
+        return layout_context;
+}
 
-        g_object_unref(context);
+static PangoLayout *layout_create(void)
+{
+        return pango_layout_new(layout_context_get());
+}
 
-        return layout;
+/**
+ * Take over the icon of the notification into the layout
+ */
+static void layout_set_icon(struct colored_layout *cl, const struct notification *n)
+{
+        if (cl->icon)
+                cairo_surface_destroy(cl->icon);
+
+        cl->icon_src = n->icon;
+
+        if (settings.icon_position != ICON_OFF && n->icon) {
+                cl->icon = cairo_surface_reference(n->icon);
+        } else {
+                cl->icon = NULL;
+        }
+        cl->damaged = true;
 }
 
-static struct colored_layout *layout_init_shared(cairo_t *c, const struct notification *n)
+/**
+ * Set the width of the layout according to the current geometry
+ */
+static void layout_set_width(struct colored_layout *cl)
 {
-        struct colored_layout *cl = g_malloc(sizeof(struct colored_layout));
-        cl->l = layout_create(c);
+        struct dimensions dim = calculate_dimensions(NULL);
+        int width = dim.w;
+
+        if (have_dynamic_width()) {
+                layout_setup_pango(cl->l, -1);
+        } else {
+                width -= 2 * settings.h_padding;
+                width -= 2 * settings.frame_width;
+                if (cl->icon) {
+                        width -= cairo_image_surface_get_width(cl->icon) + get_text_icon_padding();
+                }
+                layout_setup_pango(cl->l, width);
+        }
+}
+
+static struct colored_layout *layout_init_shared(const struct notification *n)
+{
+        struct colored_layout *cl = g_malloc0(sizeof(struct colored_layout));
+        cl->l = layout_create();
+        cl->dpi = output->get_active_screen()->dpi;
 
         if (!settings.word_wrap) {
                 PangoEllipsizeMode ellipsize;
@@ -319,56 +418,41 @@ static struct colored_layout *layout_init_shared(cairo_t *c, const struct notifi
                 pango_layout_set_ellipsize(cl->l, ellipsize);
         }
 
-        if (settings.icon_position != ICON_OFF && n->icon) {
-                cl->icon = gdk_pixbuf_to_cairo_surface(n->icon);
-        } else {
-                cl->icon = NULL;
-        }
-
-        if (cl->icon && cairo_surface_status(cl->icon) != CAIRO_STATUS_SUCCESS) {
-                cairo_surface_destroy(cl->icon);
-                cl->icon = NULL;
-        }
+        layout_set_icon(cl, n);
 
-        cl->fg = string_to_color(n->colors.fg);
-        cl->bg = string_to_color(n->colors.bg);
-        cl->highlight = string_to_color(n->colors.highlight);
-        cl->frame = string_to_color(n->colors.frame);
+        cl->fg = rgba_to_color(n->colors.fg);
+        cl->bg = rgba_to_color(n->colors.bg);
+        cl->highlight = rgba_to_color(n->colors.highlight);
+        cl->frame = rgba_to_color(n->colors.frame);
 
         cl->n = n;
 
-        struct dimensions dim = calculate_dimensions(NULL);
-        int width = dim.w;
-
-        if (have_dynamic_width()) {
-                layout_setup_pango(cl->l, -1);
-        } else {
-                width -= 2 * settings.h_padding;
-                width -= 2 * settings.frame_width;
-                if (cl->icon) {
-                        width -= cairo_image_surface_get_width(cl->icon) + get_text_icon_padding();
-                }
-                layout_setup_pango(cl->l, width);
-        }
+        layout_set_width(cl);
 
         return cl;
 }
 
-static struct colored_layout *layout_derive_xmore(cairo_t *c, const struct notification *n, int qlen)
+static struct colored_layout *layout_derive_xmore(const struct notification *n, int qlen)
 {
-        struct colored_layout *cl = layout_init_shared(c, n);
+        struct colored_layout *cl = layout_init_shared(n);
         cl->text = g_strdup_printf("(%d more)", qlen);
         cl->attr = NULL;
         pango_layout_set_text(cl->l, cl->text, -1);
         return cl;
 }
 
-static struct colored_layout *layout_from_notification(cairo_t *c, struct notification *n)
+/**
+ * Parse the text_to_render of the notification into the layout
+ */
+static void layout_set_markup(struct colored_layout *cl, struct notification *n)
 {
+        g_free(cl->markup);
+        cl->markup = g_strdup(n->text_to_render);
+        cl->damaged = true;
 
-        struct colored_layout *cl = layout_init_shared(c, n);
+        g_clear_pointer(&cl->text, g_free);
+        g_clear_pointer(&cl->attr, pango_attr_list_unref);
 
-        /* markup */
         GError *err = NULL;
         pango_parse_markup(n->text_to_render, -1, 0, &(cl->attr), &(cl->text), NULL, &err);
 
@@ -381,11 +465,48 @@ static struct colored_layout *layout_from_notification(cairo_t *c, struct notifi
                 cl->text = NULL;
                 cl->attr = NULL;
                 pango_layout_set_text(cl->l, n->text_to_render, -1);
+                pango_layout_set_attributes(cl->l, NULL);
                 if (n->first_render) {
                         LOG_W("Unable to parse markup: %s", err->message);
                 }
                 g_error_free(err);
         }
+}
+
+/**
+ * Get the layout of a displayed notification.
+ *
+ * The layout is cached and only updated partially, when the inputs
+ * of the layout have changed since the last draw pass.
+ */
+static struct colored_layout *layout_from_notification(struct notification *n)
+{
+        GHashTable *cache = layout_cache_get();
+        struct colored_layout *cl = g_hash_table_lookup(cache, n);
+
+        if (!cl) {
+                cl = layout_init_shared(n);
+                cl->cached = true;
+                notification_ref(n);
+                g_hash_table_insert(cache, n, cl);
+        } else {
+                int dpi = output->get_active_screen()->dpi;
+                if (cl->dpi != dpi) {
+                        /* update the resolution of the shared context */
+                        layout_context_get();
+                        pango_layout_context_changed(cl->l);
+                        cl->dpi = dpi;
+                        cl->damaged = true;
+                }
+                if (cl->icon_src != n->icon)
+                        layout_set_icon(cl, n);
+                layout_set_width(cl);
+        }
+
+        cl->generation = draw_generation;
+
+        if (!STR_EQ(cl->markup, n->text_to_render))
+                layout_set_markup(cl, n);
 
 
         pango_layout_get_pixel_size(cl->l, NULL, &(n->displayed_height));
@@ -402,10 +523,12 @@ static struct colored_layout *layout_from_notification(cairo_t *c, struct notifi
         return cl;
 }
 
-static GSList *create_layouts(cairo_t *c)
+static GSList *create_layouts(void)
 {
         GSList *layouts = NULL;
 
+        draw_generation++;
+
         int qlen = queues_length_waiting();
         bool xmore_is_needed = qlen > 0 && settings.indicate_hidden;
 
@@ -422,15 +545,18 @@ static GSList *create_layouts(cairo_t *c)
                         n->text_to_render = new_ttr;
                 }
                 layouts = g_slist_append(layouts,
-                                layout_from_notification(c, n));
+                                layout_from_notification(n));
         }
 
         if (xmore_is_needed && settings.geometry.h != 1) {
                 /* append xmore message as new message */
                 layouts = g_slist_append(layouts,
-                        layout_derive_xmore(c, queues_get_head_waiting(), qlen));
+                        layout_derive_xmore(queues_get_head_waiting(), qlen));
         }
 
+        /* drop the layouts of notifications, which aren't displayed anymore */
+        g_hash_table_foreach_remove(layout_cache_get(), layout_cache_is_stale, NULL);
+
         return layouts;
 }
 
@@ -703,12 +829,12 @@ static void render_content(cairo_t *c, struct colored_layout *cl, int width)
         }
 }
 
-static struct dimensions layout_render(cairo_surface_t *srf,
-                                       struct colored_layout *cl,
-                                       struct colored_layout *cl_next,
-                                       struct dimensions dim,
-                                       bool first,
-                                       bool last)
+static void layout_render(cairo_surface_t *srf,
+                          struct colored_layout *cl,
+                          struct colored_layout *cl_next,
+                          struct dimensions dim,
+                          bool first,
+                          bool last)
 {
         const int cl_h = layout_get_height(cl);
 
@@ -723,22 +849,81 @@ static struct dimensions layout_render(cairo_surface_t *srf,
 
         render_content(c, cl, bg_width);
 
-        /* adding frame */
+        cairo_destroy(c);
+        cairo_surface_destroy(content);
+}
+
+/**
+ * Get the height of the area of a layout in #back_buffer, including its
+ * part of the frame and the separator below it.
+ */
+static int layout_get_area_height(struct colored_layout *cl, bool first, bool last)
+{
+        int h = MAX(settings.notification_height, (2 * settings.padding) + layout_get_height(cl));
+
         if (first)
-                dim.y += settings.frame_width;
+                h += settings.frame_width;
+        if (last)
+                h += settings.frame_width;
+        else
+                h += settings.separator_height;
 
-        if (!last)
-                dim.y += settings.separator_height;
+        return h;
+}
 
+static struct layout_render_state layout_get_render_state(struct colored_layout *cl,
+                                                          struct colored_layout *cl_next,
+                                                          struct dimensions dim,
+                                                          bool first,
+                                                          bool last)
+{
+        struct layout_render_state state = {
+                .y = dim.y,
+                .height = layout_get_area_height(cl, first, last),
+                .width = dim.w,
+                .corner_radius = dim.corner_radius,
+                .first = first,
+                .last = last,
+                .progress = cl->n->progress,
+        };
+
+        /* same condition as in render_background() */
+        if (   settings.sep_color.type != SEP_FRAME
+            && settings.separator_height > 0
+            && !last)
+                state.sep_color = layout_get_sepcolor(cl, cl_next);
 
-        if (settings.notification_height <= (2 * settings.padding) + cl_h)
-                dim.y += cl_h + 2 * settings.padding;
-        else
-                dim.y += settings.notification_height;
+        return state;
+}
+
+static inline bool color_equal(struct color a, struct color b)
+{
+        return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+}
 
+static bool layout_render_state_equal(const struct layout_render_state *a,
+                                      const struct layout_render_state *b)
+{
+        return a->y == b->y
+            && a->height == b->height
+            && a->width == b->width
+            && a->corner_radius == b->corner_radius
+            && a->first == b->first
+            && a->last == b->last
+            && a->progress == b->progress
+            && color_equal(a->sep_color, b->sep_color);
+}
+
+/**
+ * Clear an area of #back_buffer to render a layout into it again
+ */
+static void back_buffer_clear(const cairo_rectangle_int_t *area)
+{
+        cairo_t *c = cairo_create(back_buffer);
+        cairo_set_operator(c, CAIRO_OPERATOR_CLEAR);
+        cairo_rectangle(c, area->x, area->y, area->width, area->height);
+        cairo_fill(c);
         cairo_destroy(c);
-        cairo_surface_destroy(content);
-        return dim;
 }
 
 /**
@@ -770,11 +955,21 @@ void draw(void)
 {
         assert(queues_length_displayed() > 0);
 
-        GSList *layouts = create_layouts(output->win_get_context(win));
+        GSList *layouts = create_layouts();
 
         struct dimensions dim = calculate_dimensions(layouts);
 
-        cairo_surface_t *image_surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, dim.w, dim.h);
+        /* The layouts only keep their place, while the size stays the same */
+        bool render_all = !back_buffer
+                       || cairo_image_surface_get_width(back_buffer) != dim.w
+                       || cairo_image_surface_get_height(back_buffer) != dim.h;
+        if (render_all) {
+                if (back_buffer)
+                        cairo_surface_destroy(back_buffer);
+                back_buffer = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, dim.w, dim.h);
+        }
+
+        cairo_region_t *damage = cairo_region_create();
 
         bool first = true;
         for (GSList *iter = layouts; iter; iter = iter->next) {
@@ -782,20 +977,46 @@ void draw(void)
                 struct colored_layout *cl_this = iter->data;
                 struct colored_layout *cl_next = iter->next ? iter->next->data : NULL;
 
-                dim = layout_render(image_surface, cl_this, cl_next, dim, first, !cl_next);
+                struct layout_render_state state = layout_get_render_state(cl_this, cl_next, dim, first, !cl_next);
+
+                if (   render_all
+                    || !cl_this->cached
+                    || cl_this->damaged
+                    || !layout_render_state_equal(&state, &cl_this->rendered)) {
+                        cairo_rectangle_int_t area = { 0, state.y, dim.w, state.height };
 
+                        if (!render_all)
+                                back_buffer_clear(&area);
+                        layout_render(back_buffer, cl_this, cl_next, dim, first, !cl_next);
+                        cairo_region_union_rectangle(damage, &area);
+
+                        cl_this->rendered = state;
+                        cl_this->damaged = false;
+                }
+
+                dim.y += state.height;
                 first = false;
         }
 
         calc_window_pos(dim.w, dim.h, &dim.x, &dim.y);
-        output->display_surface(image_surface, win, &dim);
+        output->display_surface(back_buffer, win, &dim, render_all ? NULL : damage);
+
+        cairo_region_destroy(damage);
 
-        cairo_surface_destroy(image_surface);
-        g_slist_free_full(layouts, free_colored_layout);
+        for (GSList *iter = layouts; iter; iter = iter->next) {
+                struct colored_layout *cl = iter->data;
+                if (!cl->cached)
+                        free_colored_layout(cl);
+        }
+        g_slist_free(layouts);
 }
 
 void draw_deinit(void)
 {
+        g_clear_pointer(&layout_cache, g_hash_table_unref);
+        g_clear_pointer(&back_buffer, cairo_surface_destroy);
+        g_clear_object(&layout_context);
+
         output->win_destroy(win);
         output->deinit();
 }
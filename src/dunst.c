@@ -12,11 +12,13 @@
 
 #include "dbus.h"
 #include "draw.h"
+#include "icon.h"
 #include "log.h"
 #include "menu.h"
 #include "notification.h"
 #include "option_parser.h"
 #include "queues.h"
+#include "rules.h"
 #include "settings.h"
 #include "utils.h"
 #include "output.h"
@@ -25,6 +27,10 @@ GMainLoop *mainloop = NULL;
 
 static struct dunst_status status;
 
+static guint wake_up_src = 0;  /**< The pending source to call run(), 0 if none is pending */
+static gint64 last_run = 0;    /**< Time of the last run() in microseconds */
+static struct dunst_redraw_stats redraw_stats = { 0, 0 };
+
 /* see dunst.h */
 void dunst_status(const enum dunst_status_field field,
                   bool value)
@@ -51,13 +57,41 @@ struct dunst_status dunst_status_get(void)
         return status;
 }
 
+/* see dunst.h */
+struct dunst_redraw_stats dunst_redraw_stats_get(void)
+{
+        return redraw_stats;
+}
+
 /* misc functions */
 static gboolean run(void *data);
 
+/**
+ * Callback for the source scheduled by wake_up()
+ */
+static gboolean run_pending(void *data)
+{
+        wake_up_src = 0;
+        return run(data);
+}
+
+/* see dunst.h */
 void wake_up(void)
 {
         LOG_D("Waking up");
-        run(NULL);
+        redraw_stats.requested++;
+
+        if (wake_up_src)
+                return;
+
+        gint64 wait = 0;
+        if (settings.max_redraw_rate > 0)
+                wait = last_run + S2US(1) / settings.max_redraw_rate - time_monotonic_now();
+
+        if (wait > 0)
+                wake_up_src = g_timeout_add(wait/1000, run_pending, NULL);
+        else
+                wake_up_src = g_idle_add(run_pending, NULL);
 }
 
 static gboolean run(void *data)
@@ -66,6 +100,14 @@ static gboolean run(void *data)
 
         LOG_D("RUN");
 
+        /* This run covers all pending requests */
+        if (wake_up_src) {
+                g_source_remove(wake_up_src);
+                wake_up_src = 0;
+        }
+        last_run = time_monotonic_now();
+        redraw_stats.performed++;
+
         dunst_status(S_FULLSCREEN, output->have_fullscreen_window());
         dunst_status(S_IDLE, output->is_idle());
 
@@ -129,11 +171,20 @@ gboolean quit_signal(gpointer data)
 
 static void teardown(void)
 {
-        regex_teardown();
+        if (wake_up_src) {
+                g_source_remove(wake_up_src);
+                wake_up_src = 0;
+        }
 
         queues_teardown();
 
         draw_deinit();
+
+        icon_teardown();
+
+        rules_teardown();
+
+        notification_formats_teardown();
 }
 
 int dunst_main(int argc, char *argv[])
@@ -168,6 +219,8 @@ int dunst_main(int argc, char *argv[])
                 usage(EXIT_SUCCESS);
         }
 
+        icon_loader_init();
+
         int dbus_owner_id = dbus_init();
 
         mainloop = g_main_loop_new(NULL, FALSE);
@@ -33,6 +33,24 @@ void dunst_status(const enum dunst_status_field field,
 
 struct dunst_status dunst_status_get(void);
 
+//!< Counters to compare the requested redraws with the actually performed ones
+struct dunst_redraw_stats {
+        guint64 requested; //!< calls of wake_up()
+        guint64 performed; //!< updates of the queues and the window
+};
+
+/**
+ * Get the current redraw counters
+ */
+struct dunst_redraw_stats dunst_redraw_stats_get(void);
+
+/**
+ * Schedule an update of the queues and a redraw of the window.
+ *
+ * All requests until the main loop gets idle are coalesced into a
+ * single update. Updates happen at most settings.max_redraw_rate
+ * times per second.
+ */
 void wake_up(void);
 
 int dunst_main(int argc, char *argv[]);
@@ -3,19 +3,406 @@
 #include <assert.h>
 #include <cairo.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
+#include <gio/gio.h>
+#include <math.h>
 #include <stdbool.h>
 #include <string.h>
+#include <sys/stat.h>
 
+#include "icon_theme.h"
 #include "log.h"
 #include "notification.h"
 #include "settings.h"
 #include "utils.h"
 
+/** The surfaces of all icons in use: icon id -> cairo_surface_t* (not referenced) */
+static GHashTable *icon_surfaces = NULL;
+
+/** Key to attach the icon id to its surface */
+static const cairo_user_data_key_t icon_surface_id_key;
+/** The key of the surface attached to a pixbuf by icon_pixbuf_prepare() */
+static const char *icon_pixbuf_surface_key = "dunst-icon-surface";
+
+/** A decoded icon file in #icon_cache */
+struct icon_cache_entry {
+        char *key;              /**< The icon name and the icon sizes it got scaled to */
+        char *path;             /**< The file the icon name resolved to, NULL for raw icon data */
+        gint64 mtime;           /**< Modification time of #path when decoded in nanoseconds */
+        GdkPixbuf *pixbuf;
+        gsize size;             /**< Memory used by #pixbuf and its surface in bytes */
+        GList lru;              /**< Link in #icon_cache_lru, data points to the entry */
+};
+
+/** The decoded icons by their key: char* -> struct icon_cache_entry* */
+static GHashTable *icon_cache = NULL;
+/** All entries of #icon_cache, the most recently used first */
+static GQueue icon_cache_lru = G_QUEUE_INIT;
+/** Sum of the sizes of all entries in #icon_cache */
+static gsize icon_cache_used = 0;
+static struct icon_cache_stats icon_cache_stats = { 0, 0 };
+
+/** The file suffixes of icons in the icon_path, the preferred ones first */
+static const char *icon_suffixes[] = { ".svg", ".svgz", ".png", ".xpm", NULL };
+
+/** An icon file found in one of the icon_path directories */
+struct icon_path_entry {
+        char *path;
+        int priority;           /**< Lower values win. Earlier directories first, then by suffix. */
+};
+
+/** All icons in the icon_path: icon name -> struct icon_path_entry* */
+static GHashTable *icon_path_index = NULL;
+/** The value of settings.icon_path, when #icon_path_index got built */
+static char *icon_path_indexed = NULL;
+/** Monitors for all directories in #icon_path_indexed */
+static GPtrArray *icon_path_monitors = NULL;
+/** A directory in the icon_path changed, #icon_path_index has to get rebuilt */
+static bool icon_path_index_dirty = false;
+
+//!< A file icon, which gets decoded by #icon_loader
+struct icon_load {
+        char *key;         //!< The key in #icon_loads and #icon_cache
+        char *name;        //!< The requested icon name, used as the icon id
+        char *path;        //!< The resolved path of the icon file
+        GdkPixbuf *pixbuf; //!< The decoded icon, written by the worker thread
+        GQueue waiters;    //!< The callbacks waiting for the icon
+};
+
+//!< A caller of icon_get_for_name_async(), waiting for an icon
+struct icon_load_waiter {
+        icon_loaded_cb callback;
+        gpointer data;
+        GDestroyNotify destroy;
+};
+
+/** The worker threads decoding icon files, NULL if icons get decoded synchronously */
+static GThreadPool *icon_loader = NULL;
+/** The loads in progress, mapping their cache key to the struct icon_load */
+static GHashTable *icon_loads = NULL;
+
 static bool is_readable_file(const char *filename)
 {
         return (access(filename, R_OK) != -1);
 }
 
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+static const size_t CAIRO_B = 0;
+static const size_t CAIRO_G = 1;
+static const size_t CAIRO_R = 2;
+static const size_t CAIRO_A = 3;
+#elif G_BYTE_ORDER == G_BIG_ENDIAN
+static const size_t CAIRO_A = 0;
+static const size_t CAIRO_R = 1;
+static const size_t CAIRO_G = 2;
+static const size_t CAIRO_B = 3;
+#elif G_BYTE_ORDER == G_PDP_ENDIAN
+static const size_t CAIRO_R = 0;
+static const size_t CAIRO_A = 1;
+static const size_t CAIRO_B = 2;
+static const size_t CAIRO_G = 3;
+#else
+// GLib doesn't support any other endiannesses
+#error Unsupported Endianness
+#endif
+
+/**
+ * Converts a single row of pixbuf pixels into the cairo pixel format
+ *
+ * @param src The first pixel of the pixbuf row
+ * @param dst The first pixel of the cairo row
+ * @param width The amount of pixels in the row
+ */
+typedef void (*pixbuf_row_converter)(const unsigned char *src, unsigned char *dst, int width);
+
+/** A premultiplied pixel with the channels red, green, blue and alpha */
+typedef float icon_pixel __attribute__((vector_size(16)));
+
+/**
+ * Premultiplies a single row of pixbuf pixels and adds them, multiplied
+ * by a weight, to the accumulated pixels of a box filter
+ *
+ * @param acc The accumulated pixels
+ * @param src The first pixel of the pixbuf row
+ * @param width The amount of pixels in the row
+ * @param weight The weight of the row
+ */
+typedef void (*pixbuf_box_accumulator)(icon_pixel *acc, const unsigned char *src, int width, float weight);
+
+/**
+ * Premultiply a color channel with the alpha value.
+ *
+ * Gives exactly the same result as `(unsigned char)(c * a / 255.0 + .5)`
+ * without any division or floating point math.
+ */
+static inline unsigned char premultiply(unsigned char c, unsigned char a)
+{
+        unsigned int t = c * a + 128;
+        return (t + (t >> 8)) >> 8;
+}
+
+static void pixbuf_row_rgb_scalar(const unsigned char *src, unsigned char *dst, int width)
+{
+        for (int w = 0; w < width; w++) {
+                dst[CAIRO_R] = src[0];
+                dst[CAIRO_G] = src[1];
+                dst[CAIRO_B] = src[2];
+                dst[CAIRO_A] = 0xff;
+                dst += 4;
+                src += 3;
+        }
+}
+
+static void pixbuf_row_rgba_scalar(const unsigned char *src, unsigned char *dst, int width)
+{
+        for (int w = 0; w < width; w++) {
+                dst[CAIRO_R] = premultiply(src[0], src[3]);
+                dst[CAIRO_G] = premultiply(src[1], src[3]);
+                dst[CAIRO_B] = premultiply(src[2], src[3]);
+                dst[CAIRO_A] = src[3];
+                dst += 4;
+                src += 4;
+        }
+}
+
+static void pixbuf_box_rgb_scalar(icon_pixel *acc, const unsigned char *src, int width, float weight)
+{
+        for (int x = 0; x < width; x++, src += 3)
+                acc[x] += (icon_pixel) { src[0], src[1], src[2], 0xff } * weight;
+}
+
+static void pixbuf_box_rgba_scalar(icon_pixel *acc, const unsigned char *src, int width, float weight)
+{
+        float scale = weight / 0xff;
+
+        for (int x = 0; x < width; x++, src += 4)
+                acc[x] += (icon_pixel) { src[0], src[1], src[2], 0xff } * (src[3] * scale);
+}
+
+/* The vectorized kernels write the little endian layout of cairo (BGRA),
+ * which is always given on x86. */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_KERNELS
+#include <immintrin.h>
+
+/* Shuffle mask to spread 4 packed RGB pixels (12 bytes) to BGRx */
+#define RGB_TO_BGRX 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1
+
+__attribute__((target("ssse3")))
+static void pixbuf_row_rgb_ssse3(const unsigned char *src, unsigned char *dst, int width)
+{
+        const __m128i mask = _mm_setr_epi8(RGB_TO_BGRX);
+        const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+        int x = 0;
+
+        /* The load reads 16 bytes, but only 12 get used. Stop early
+         * enough to not read past the end of the row. */
+        for (; width - x >= 6; x += 4) {
+                __m128i px = _mm_loadu_si128((const __m128i *)(src + 3 * x));
+                px = _mm_or_si128(_mm_shuffle_epi8(px, mask), alpha);
+                _mm_storeu_si128((__m128i *)(dst + 4 * x), px);
+        }
+
+        pixbuf_row_rgb_scalar(src + 3 * x, dst + 4 * x, width - x);
+}
+
+__attribute__((target("avx2")))
+static void pixbuf_row_rgb_avx2(const unsigned char *src, unsigned char *dst, int width)
+{
+        /* Move the pixels 4-7 (bytes 12-27) into the upper lane */
+        const __m256i spread = _mm256_setr_epi32(0, 1, 2, 3, 3, 4, 5, 6);
+        const __m256i mask = _mm256_setr_epi8(RGB_TO_BGRX, RGB_TO_BGRX);
+        const __m256i alpha = _mm256_set1_epi32((int)0xff000000);
+        int x = 0;
+
+        for (; width - x >= 11; x += 8) {
+                __m256i px = _mm256_loadu_si256((const __m256i *)(src + 3 * x));
+                px = _mm256_permutevar8x32_epi32(px, spread);
+                px = _mm256_or_si256(_mm256_shuffle_epi8(px, mask), alpha);
+                _mm256_storeu_si256((__m256i *)(dst + 4 * x), px);
+        }
+
+        pixbuf_row_rgb_ssse3(src + 3 * x, dst + 4 * x, width - x);
+}
+/**
+ * Premultiply two RGBA pixels, which are unpacked to 16 bit per channel,
+ * and swap their R and B channels.
+ *
+ * Uses the same integer approximation as premultiply(). The alpha channel
+ * gets multiplied by 255, which leaves it unchanged.
+ */
+__attribute__((target("sse2")))
+static inline __m128i premultiply_sse2(__m128i c)
+{
+        const __m128i color = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+        const __m128i opaque = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+        const __m128i round = _mm_set1_epi16(128);
+
+        __m128i a = _mm_shufflelo_epi16(c, _MM_SHUFFLE(3, 3, 3, 3));
+        a = _mm_shufflehi_epi16(a, _MM_SHUFFLE(3, 3, 3, 3));
+        a = _mm_or_si128(_mm_and_si128(a, color), opaque);
+
+        __m128i t = _mm_add_epi16(_mm_mullo_epi16(c, a), round);
+        t = _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+
+        t = _mm_shufflelo_epi16(t, _MM_SHUFFLE(3, 0, 1, 2));
+        return _mm_shufflehi_epi16(t, _MM_SHUFFLE(3, 0, 1, 2));
+}
+
+__attribute__((target("sse2")))
+static void pixbuf_row_rgba_sse2(const unsigned char *src, unsigned char *dst, int width)
+{
+        const __m128i zero = _mm_setzero_si128();
+        int x = 0;
+
+        for (; width - x >= 4; x += 4) {
+                __m128i px = _mm_loadu_si128((const __m128i *)(src + 4 * x));
+                __m128i lo = premultiply_sse2(_mm_unpacklo_epi8(px, zero));
+                __m128i hi = premultiply_sse2(_mm_unpackhi_epi8(px, zero));
+                _mm_storeu_si128((__m128i *)(dst + 4 * x), _mm_packus_epi16(lo, hi));
+        }
+
+        pixbuf_row_rgba_scalar(src + 4 * x, dst + 4 * x, width - x);
+}
+
+/** The AVX2 variant of premultiply_sse2(), working on four pixels */
+__attribute__((target("avx2")))
+static inline __m256i premultiply_avx2(__m256i c)
+{
+        const __m256i color = _mm256_set_epi16(0, -1, -1, -1, 0, -1, -1, -1,
+                                               0, -1, -1, -1, 0, -1, -1, -1);
+        const __m256i opaque = _mm256_set_epi16(255, 0, 0, 0, 255, 0, 0, 0,
+                                                255, 0, 0, 0, 255, 0, 0, 0);
+        const __m256i round = _mm256_set1_epi16(128);
+
+        __m256i a = _mm256_shufflelo_epi16(c, _MM_SHUFFLE(3, 3, 3, 3));
+        a = _mm256_shufflehi_epi16(a, _MM_SHUFFLE(3, 3, 3, 3));
+        a = _mm256_or_si256(_mm256_and_si256(a, color), opaque);
+
+        __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(c, a), round);
+        t = _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+
+        t = _mm256_shufflelo_epi16(t, _MM_SHUFFLE(3, 0, 1, 2));
+        return _mm256_shufflehi_epi16(t, _MM_SHUFFLE(3, 0, 1, 2));
+}
+
+__attribute__((target("avx2")))
+static void pixbuf_row_rgba_avx2(const unsigned char *src, unsigned char *dst, int width)
+{
+        const __m256i zero = _mm256_setzero_si256();
+        int x = 0;
+
+        /* Unpacking and packing both work per 128 bit lane, so the
+         * pixels end up in their original order again. */
+        for (; width - x >= 8; x += 8) {
+                __m256i px = _mm256_loadu_si256((const __m256i *)(src + 4 * x));
+                __m256i lo = premultiply_avx2(_mm256_unpacklo_epi8(px, zero));
+                __m256i hi = premultiply_avx2(_mm256_unpackhi_epi8(px, zero));
+                _mm256_storeu_si256((__m256i *)(dst + 4 * x), _mm256_packus_epi16(lo, hi));
+        }
+
+        pixbuf_row_rgba_sse2(src + 4 * x, dst + 4 * x, width - x);
+}
+
+/* Widen the four bytes at src to floats */
+__attribute__((target("sse2")))
+static inline __m128 pixbuf_box_load_sse2(const unsigned char *src)
+{
+        const __m128i zero = _mm_setzero_si128();
+        int v;
+
+        memcpy(&v, src, sizeof(v));
+        __m128i px = _mm_unpacklo_epi8(_mm_cvtsi32_si128(v), zero);
+        return _mm_cvtepi32_ps(_mm_unpacklo_epi16(px, zero));
+}
+
+__attribute__((target("sse2")))
+static void pixbuf_box_rgb_sse2(icon_pixel *acc, const unsigned char *src, int width, float weight)
+{
+        const __m128 color = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+        const __m128 opaque = _mm_set_ps(0xff, 0, 0, 0);
+        const __m128 w = _mm_set1_ps(weight);
+        int x = 0;
+
+        /* Every load reads the red byte of the next pixel, so the last
+         * pixel has to be done separately */
+        for (; x < width - 1; x++) {
+                __m128 px = _mm_or_ps(_mm_and_ps(pixbuf_box_load_sse2(src + 3 * x), color), opaque);
+                acc[x] = (icon_pixel) _mm_add_ps((__m128) acc[x], _mm_mul_ps(px, w));
+        }
+
+        pixbuf_box_rgb_scalar(acc + x, src + 3 * x, width - x, weight);
+}
+
+__attribute__((target("sse2")))
+static void pixbuf_box_rgba_sse2(icon_pixel *acc, const unsigned char *src, int width, float weight)
+{
+        const __m128 color = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+        const __m128 opaque = _mm_set_ps(0xff, 0, 0, 0);
+        const __m128 scale = _mm_set1_ps(weight / 0xff);
+
+        for (int x = 0; x < width; x++) {
+                __m128 px = pixbuf_box_load_sse2(src + 4 * x);
+                __m128 a = _mm_mul_ps(_mm_shuffle_ps(px, px, _MM_SHUFFLE(3, 3, 3, 3)), scale);
+                px = _mm_or_ps(_mm_and_ps(px, color), opaque);
+                acc[x] = (icon_pixel) _mm_add_ps((__m128) acc[x], _mm_mul_ps(px, a));
+        }
+}
+
+static bool cpu_has_avx2(void)  { return __builtin_cpu_supports("avx2"); }
+static bool cpu_has_ssse3(void) { return __builtin_cpu_supports("ssse3"); }
+static bool cpu_has_sse2(void)  { return __builtin_cpu_supports("sse2"); }
+#endif /* HAVE_X86_KERNELS */
+
+static bool cpu_has_nothing(void) { return true; }
+
+/** A set of row converters, which require a specific CPU feature */
+struct pixbuf_kernel {
+        const char *name;
+        bool (*supported)(void);
+        pixbuf_row_converter rgb;
+        pixbuf_row_converter rgba;
+        pixbuf_box_accumulator box_rgb;
+        pixbuf_box_accumulator box_rgba;
+};
+
+/** All available kernels, the preferred ones first */
+static const struct pixbuf_kernel pixbuf_kernels[] = {
+#ifdef HAVE_X86_KERNELS
+        { "avx2",   cpu_has_avx2,    pixbuf_row_rgb_avx2,    pixbuf_row_rgba_avx2,
+                                     pixbuf_box_rgb_sse2,    pixbuf_box_rgba_sse2 },
+        { "ssse3",  cpu_has_ssse3,   pixbuf_row_rgb_ssse3,   pixbuf_row_rgba_sse2,
+                                     pixbuf_box_rgb_sse2,    pixbuf_box_rgba_sse2 },
+        { "sse2",   cpu_has_sse2,    pixbuf_row_rgb_scalar,  pixbuf_row_rgba_sse2,
+                                     pixbuf_box_rgb_sse2,    pixbuf_box_rgba_sse2 },
+#endif
+        { "scalar", cpu_has_nothing, pixbuf_row_rgb_scalar,  pixbuf_row_rgba_scalar,
+                                     pixbuf_box_rgb_scalar,  pixbuf_box_rgba_scalar },
+};
+
+/**
+ * Get the best kernel for the current CPU. The detection only happens once.
+ */
+static const struct pixbuf_kernel *pixbuf_kernel_get(void)
+{
+        static const struct pixbuf_kernel *kernel = NULL;
+
+        if (kernel)
+                return kernel;
+
+#ifdef HAVE_X86_KERNELS
+        __builtin_cpu_init();
+#endif
+        for (size_t i = 0; i < G_N_ELEMENTS(pixbuf_kernels); i++) {
+                if (pixbuf_kernels[i].supported()) {
+                        kernel = &pixbuf_kernels[i];
+                        break;
+                }
+        }
+
+        LOG_D("Converting icons with the %s kernel", kernel->name);
+        return kernel;
+}
+
 /**
  * Reassemble the data parts of a GdkPixbuf into a cairo_surface_t's data field.
  *
@@ -30,60 +417,16 @@ static void pixbuf_data_to_cairo_data(
                 int height,
                 int n_channels)
 {
-#if G_BYTE_ORDER == G_LITTLE_ENDIAN
-        static const size_t CAIRO_B = 0;
-        static const size_t CAIRO_G = 1;
-        static const size_t CAIRO_R = 2;
-        static const size_t CAIRO_A = 3;
-#elif G_BYTE_ORDER == G_BIG_ENDIAN
-        static const size_t CAIRO_A = 0;
-        static const size_t CAIRO_R = 1;
-        static const size_t CAIRO_G = 2;
-        static const size_t CAIRO_B = 3;
-#elif G_BYTE_ORDER == G_PDP_ENDIAN
-        static const size_t CAIRO_R = 0;
-        static const size_t CAIRO_A = 1;
-        static const size_t CAIRO_B = 2;
-        static const size_t CAIRO_G = 3;
-#else
-// GLib doesn't support any other endiannesses
-#error Unsupported Endianness
-#endif
-
         assert(pixels_p);
         assert(pixels_c);
         assert(width > 0);
         assert(height > 0);
 
-        if (n_channels == 3) {
-                for (int h = 0; h < height; h++) {
-                              unsigned char *iter_c = pixels_c + h * rowstride_c;
-                        const unsigned char *iter_p = pixels_p + h * rowstride_p;
-                        for (int w = 0; w < width; w++) {
-                                iter_c[CAIRO_R] = iter_p[0];
-                                iter_c[CAIRO_G] = iter_p[1];
-                                iter_c[CAIRO_B] = iter_p[2];
-                                iter_c[CAIRO_A] = 0xff;
-                                iter_c += 4;
-                                iter_p += n_channels;
-                        }
-                }
-        } else {
-                for (int h = 0; h < height; h++) {
-                              unsigned char *iter_c = pixels_c + h * rowstride_c;
-                        const unsigned char *iter_p = pixels_p + h * rowstride_p;
-                        for (int w = 0; w < width; w++) {
-                                double alpha_factor = iter_p[3] / (double)0xff;
-                                iter_c[CAIRO_R] = (unsigned char)(iter_p[0] * alpha_factor + .5);
-                                iter_c[CAIRO_G] = (unsigned char)(iter_p[1] * alpha_factor + .5);
-                                iter_c[CAIRO_B] = (unsigned char)(iter_p[2] * alpha_factor + .5);
-                                iter_c[CAIRO_A] =                 iter_p[3];
-                                iter_c += 4;
-                                iter_p += n_channels;
-                        }
-                }
+        const struct pixbuf_kernel *kernel = pixbuf_kernel_get();
+        pixbuf_row_converter convert = n_channels == 3 ? kernel->rgb : kernel->rgba;
 
-        }
+        for (int h = 0; h < height; h++)
+                convert(pixels_p + h * rowstride_p, pixels_c + h * rowstride_c, width);
 }
 
 cairo_surface_t *gdk_pixbuf_to_cairo_surface(GdkPixbuf *pixbuf)
@@ -139,32 +482,306 @@ static bool icon_size_clamp(int *w, int *h) {
         return FALSE;
 }
 
+//!< The source pixels, which cover a pixel of a downscaled image
+struct icon_box_span {
+        int first;      //!< The first source pixel
+        int count;      //!< The amount of source pixels
+        int weights;    //!< Index of the weight of the first pixel in icon_box_filter.weights
+};
+
+//!< A box filter downscaling one dimension of an image
+struct icon_box_filter {
+        struct icon_box_span *spans;    //!< The span of every target pixel
+        float *weights;                 //!< The weights of all spans, each summing up to 1
+};
+
+/**
+ * Calculate, which part of the source pixels covers each target pixel.
+ *
+ * @param src The size of the source in pixels
+ * @param dst The size of the target in pixels, at most @p src
+ */
+static struct icon_box_filter icon_box_filter_new(int src, int dst)
+{
+        double scale = (double) src / dst;
+        int max_count = (int) ceil(scale) + 1;
+        struct icon_box_filter filter = {
+                .spans = g_new(struct icon_box_span, dst),
+                .weights = g_new(float, (gsize) dst * max_count),
+        };
+
+        for (int i = 0; i < dst; i++) {
+                double start = i * scale;
+                double end = MIN((i + 1) * scale, src);
+                struct icon_box_span *span = &filter.spans[i];
+
+                span->first = (int) start;
+                span->count = MIN((int) ceil(end), src) - span->first;
+                span->weights = i * max_count;
+
+                for (int j = 0; j < span->count; j++) {
+                        double from = MAX(start, span->first + j);
+                        double to = MIN(end, span->first + j + 1);
+                        filter.weights[span->weights + j] = (to - from) / (end - start);
+                }
+        }
+
+        return filter;
+}
+
+static void icon_box_filter_free(struct icon_box_filter *filter)
+{
+        g_free(filter->spans);
+        g_free(filter->weights);
+}
+
 /**
- * Scales the given GdkPixbuf if necessary according to the settings.
+ * Downscale a pixbuf with a box filter into a cairo surface, a pixbuf or both.
  *
- * @param pixbuf (nullable) The pixbuf, which may be too big.
+ * In contrast to bilinear scaling, every source pixel contributes to the
+ * result, so large downscales don't alias. The pixels get premultiplied
+ * by the kernel on the fly, so the surface doesn't need the conversion of
+ * gdk_pixbuf_to_cairo_surface(). The pixbuf gets the same pixels without
+ * the premultiplication.
+ *
+ * @param pixbuf The pixbuf with 8 bit RGB or RGBA samples
+ * @param surface (nullable) The target surface in the format matching @p pixbuf
+ * @param scaled (nullable) The target pixbuf in the format of @p pixbuf
+ * @param width The width of the targets, at most the width of @p pixbuf
+ * @param height The height of the targets, at most the height of @p pixbuf
+ */
+static void icon_downscale(GdkPixbuf *pixbuf,
+                           cairo_surface_t *surface,
+                           GdkPixbuf *scaled,
+                           int width,
+                           int height)
+{
+        int src_width = gdk_pixbuf_get_width(pixbuf);
+        int src_height = gdk_pixbuf_get_height(pixbuf);
+        int rowstride = gdk_pixbuf_get_rowstride(pixbuf);
+        bool has_alpha = gdk_pixbuf_get_has_alpha(pixbuf);
+        int channels = gdk_pixbuf_get_n_channels(pixbuf);
+        const unsigned char *pixels = gdk_pixbuf_read_pixels(pixbuf);
+
+        assert(width > 0 && width <= src_width);
+        assert(height > 0 && height <= src_height);
+        assert(channels == (has_alpha ? 4 : 3));
+
+        struct icon_box_filter horizontal = icon_box_filter_new(src_width, width);
+        struct icon_box_filter vertical = icon_box_filter_new(src_height, height);
+        icon_pixel *acc = g_new(icon_pixel, src_width);
+        const struct pixbuf_kernel *kernel = pixbuf_kernel_get();
+        pixbuf_box_accumulator accumulate = has_alpha ? kernel->box_rgba : kernel->box_rgb;
+
+        unsigned char *data = NULL;
+        int stride = 0;
+        if (surface) {
+                cairo_surface_flush(surface);
+                data = cairo_image_surface_get_data(surface);
+                stride = cairo_image_surface_get_stride(surface);
+        }
+
+        for (int y = 0; y < height; y++) {
+                const struct icon_box_span *vspan = &vertical.spans[y];
+
+                memset(acc, 0, sizeof(icon_pixel) * src_width);
+                for (int j = 0; j < vspan->count; j++)
+                        accumulate(acc,
+                                   pixels + (vspan->first + j) * rowstride,
+                                   src_width,
+                                   vertical.weights[vspan->weights + j]);
+
+                guint32 *dst = data ? (guint32 *)(data + y * stride) : NULL;
+                unsigned char *straight = scaled
+                        ? gdk_pixbuf_get_pixels(scaled) + y * gdk_pixbuf_get_rowstride(scaled)
+                        : NULL;
+
+                for (int x = 0; x < width; x++) {
+                        const struct icon_box_span *hspan = &horizontal.spans[x];
+                        const float *weights = &horizontal.weights[hspan->weights];
+                        icon_pixel sum = { 0, 0, 0, 0 };
+
+                        for (int i = 0; i < hspan->count; i++)
+                                sum += acc[hspan->first + i] * weights[i];
+
+                        if (straight) {
+                                unsigned char *px = straight + x * channels;
+                                float alpha = sum[3];
+                                icon_pixel color = alpha > 0 ? sum * (0xff / alpha) : sum;
+
+                                for (int c = 0; c < 3; c++)
+                                        px[c] = (unsigned char) MIN(color[c] + 0.5f, 0xff);
+                                if (has_alpha)
+                                        px[3] = (unsigned char) (alpha + 0.5f);
+                        }
+
+                        if (dst) {
+                                sum += 0.5f;
+                                dst[x] = (guint32) sum[3] << 24
+                                       | (guint32) sum[0] << 16
+                                       | (guint32) sum[1] << 8
+                                       | (guint32) sum[2];
+                        }
+                }
+        }
+
+        if (surface)
+                cairo_surface_mark_dirty(surface);
+
+        g_free(acc);
+        icon_box_filter_free(&horizontal);
+        icon_box_filter_free(&vertical);
+}
+
+/**
+ * Downscale a pixbuf with a box filter into a new cairo surface.
+ *
+ * @param pixbuf The pixbuf with 8 bit RGB or RGBA samples
+ * @param width The width of the surface, at most the width of @p pixbuf
+ * @param height The height of the surface, at most the height of @p pixbuf
+ */
+static cairo_surface_t *icon_downscale_to_surface(GdkPixbuf *pixbuf, int width, int height)
+{
+        cairo_format_t fmt = gdk_pixbuf_get_has_alpha(pixbuf) ? CAIRO_FORMAT_ARGB32 : CAIRO_FORMAT_RGB24;
+        cairo_surface_t *surface = cairo_image_surface_create(fmt, width, height);
+
+        if (cairo_surface_status(surface) == CAIRO_STATUS_SUCCESS)
+                icon_downscale(pixbuf, surface, NULL, width, height);
+
+        return surface;
+}
+
+/**
+ * Remove a surface, which is about to get destroyed, from #icon_surfaces.
+ * Matches the signature of cairo_destroy_func_t.
+ *
+ * @param data The id of the surface
+ */
+static void icon_surface_forget(void *data)
+{
+        char *id = data;
+
+        g_hash_table_remove(icon_surfaces, id);
+        g_free(id);
+}
+
+/* see icon.h */
+cairo_surface_t *icon_get_surface(GdkPixbuf *pixbuf, const char *id)
+{
+        ASSERT_OR_RET(pixbuf, NULL);
+
+        if (!icon_surfaces)
+                icon_surfaces = g_hash_table_new(g_str_hash, g_str_equal);
+
+        int src_width = gdk_pixbuf_get_width(pixbuf);
+        int src_height = gdk_pixbuf_get_height(pixbuf);
+        int width = src_width;
+        int height = src_height;
+        bool scale = icon_size_clamp(&width, &height);
+        width = MAX(width, 1);
+        height = MAX(height, 1);
+
+        /* The same icon may be shown in multiple sizes, when the icon
+         * size limits changed */
+        char *key = id ? g_strdup_printf("%dx%d:%s", width, height, id) : NULL;
+        cairo_surface_t *surface = key ? g_hash_table_lookup(icon_surfaces, key) : NULL;
+        if (surface) {
+                g_free(key);
+                return cairo_surface_reference(surface);
+        }
+
+        surface = g_object_get_data(G_OBJECT(pixbuf), icon_pixbuf_surface_key);
+        if (surface && cairo_image_surface_get_width(surface) == width
+            && cairo_image_surface_get_height(surface) == height) {
+                surface = cairo_surface_reference(surface);
+        } else if (!scale) {
+                surface = gdk_pixbuf_to_cairo_surface(pixbuf);
+        } else if (width <= src_width && height <= src_height
+                   && gdk_pixbuf_get_bits_per_sample(pixbuf) == 8) {
+                surface = icon_downscale_to_surface(pixbuf, width, height);
+        } else {
+                GdkPixbuf *scaled = gdk_pixbuf_scale_simple(pixbuf, width, height, GDK_INTERP_BILINEAR);
+                surface = gdk_pixbuf_to_cairo_surface(scaled);
+                g_object_unref(scaled);
+        }
+
+        if (cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS) {
+                cairo_surface_destroy(surface);
+                g_free(key);
+                return NULL;
+        }
+
+        if (key) {
+                g_hash_table_insert(icon_surfaces, key, surface);
+                cairo_surface_set_user_data(surface, &icon_surface_id_key, key, icon_surface_forget);
+        }
+
+        return surface;
+}
+
+/**
+ * Scale the given GdkPixbuf to fit between settings.min_icon_size and
+ * settings.max_icon_size and attach the cairo surface to draw it, which
+ * icon_get_surface() picks up.
+ *
+ * Downscaling uses a box filter, which writes the pixbuf and the surface
+ * in one pass. This is meant to run before the pixbuf gets cached or
+ * handed to the main loop, so the main loop doesn't touch any pixels.
+ *
+ * @param pixbuf (nullable) The pixbuf, which may be too small or too big.
  *                          Takes ownership of the reference.
  * @return the scaled version of the pixbuf. If scaling wasn't
  *         necessary, it returns the same pixbuf. Transfers full
  *         ownership of the reference.
  */
-static GdkPixbuf *icon_pixbuf_scale(GdkPixbuf *pixbuf)
+static GdkPixbuf *icon_pixbuf_prepare(GdkPixbuf *pixbuf)
 {
         ASSERT_OR_RET(pixbuf, NULL);
 
-        int w = gdk_pixbuf_get_width(pixbuf);
-        int h = gdk_pixbuf_get_height(pixbuf);
+        int orig_w = gdk_pixbuf_get_width(pixbuf);
+        int orig_h = gdk_pixbuf_get_height(pixbuf);
+        int w = orig_w;
+        int h = orig_h;
+        cairo_surface_t *surface = NULL;
 
         if (icon_size_clamp(&w, &h)) {
-                GdkPixbuf *scaled = gdk_pixbuf_scale_simple(
-                                pixbuf,
-                                w,
-                                h,
-                                GDK_INTERP_BILINEAR);
-                g_object_unref(pixbuf);
-                pixbuf = scaled;
+                GdkPixbuf *scaled;
+                w = MAX(w, 1);
+                h = MAX(h, 1);
+
+                if (w <= orig_w && h <= orig_h && gdk_pixbuf_get_bits_per_sample(pixbuf) == 8) {
+                        bool has_alpha = gdk_pixbuf_get_has_alpha(pixbuf);
+                        cairo_format_t fmt = has_alpha ? CAIRO_FORMAT_ARGB32 : CAIRO_FORMAT_RGB24;
+
+                        scaled = gdk_pixbuf_new(GDK_COLORSPACE_RGB, has_alpha, 8, w, h);
+                        surface = cairo_image_surface_create(fmt, w, h);
+                        if (scaled && cairo_surface_status(surface) == CAIRO_STATUS_SUCCESS) {
+                                icon_downscale(pixbuf, surface, scaled, w, h);
+                        } else {
+                                g_clear_pointer(&surface, cairo_surface_destroy);
+                                g_clear_pointer(&scaled, g_object_unref);
+                        }
+                } else {
+                        scaled = gdk_pixbuf_scale_simple(pixbuf, w, h, GDK_INTERP_BILINEAR);
+                }
+
+                if (scaled) {
+                        g_object_unref(pixbuf);
+                        pixbuf = scaled;
+                }
         }
 
+        if (!surface)
+                surface = gdk_pixbuf_to_cairo_surface(pixbuf);
+
+        if (cairo_surface_status(surface) == CAIRO_STATUS_SUCCESS)
+                g_object_set_data_full(G_OBJECT(pixbuf),
+                                       icon_pixbuf_surface_key,
+                                       surface,
+                                       (GDestroyNotify) cairo_surface_destroy);
+        else
+                cairo_surface_destroy(surface);
+
         return pixbuf;
 }
 
@@ -174,12 +791,31 @@ GdkPixbuf *get_pixbuf_from_file(const char *filename)
         GError *error = NULL;
         gint w, h;
 
-        if (!gdk_pixbuf_get_file_info (path, &w, &h)) {
+        GdkPixbufFormat *format = gdk_pixbuf_get_file_info(path, &w, &h);
+        if (!format) {
                 LOG_W("Failed to load image info for %s", filename);
                 g_free(path);
                 return NULL;
         }
-        icon_size_clamp(&w, &h);
+
+        /* Vector images get rendered in the right size. Raster images get
+         * downscaled with the box filter of icon_pixbuf_prepare(), as the
+         * bilinear scaling of the loaders aliases. Only the JPEG loader
+         * decodes at a fraction of the size, so let it decode to twice
+         * the target size, which the bilinear scaling handles fine. */
+        int orig_w = w, orig_h = h;
+        if (icon_size_clamp(&w, &h) && (w < orig_w || h < orig_h)
+            && !gdk_pixbuf_format_is_scalable(format)) {
+                char *name = gdk_pixbuf_format_get_name(format);
+                if (STR_EQ(name, "jpeg") && 2 * w < orig_w && 2 * h < orig_h) {
+                        w *= 2;
+                        h *= 2;
+                } else {
+                        w = orig_w;
+                        h = orig_h;
+                }
+                g_free(name);
+        }
         GdkPixbuf *pixbuf = gdk_pixbuf_new_from_file_at_scale(path,
                                                               w,
                                                               h,
@@ -192,7 +828,153 @@ GdkPixbuf *get_pixbuf_from_file(const char *filename)
         }
 
         g_free(path);
-        return pixbuf;
+        return icon_pixbuf_prepare(pixbuf);
+}
+
+static void icon_path_entry_free(gpointer data)
+{
+        struct icon_path_entry *entry = data;
+
+        g_free(entry->path);
+        g_free(entry);
+}
+
+static void icon_path_index_changed(GFileMonitor *monitor,
+                                    GFile *file,
+                                    GFile *other_file,
+                                    GFileMonitorEvent event_type,
+                                    gpointer user_data)
+{
+        icon_path_index_dirty = true;
+}
+
+static void icon_path_index_clear(void)
+{
+        g_clear_pointer(&icon_path_index, g_hash_table_unref);
+        g_clear_pointer(&icon_path_monitors, g_ptr_array_unref);
+        g_clear_pointer(&icon_path_indexed, g_free);
+}
+
+/**
+ * Add all icon files of a directory in the icon_path to #icon_path_index.
+ *
+ * @param folder The directory to scan
+ * @param position The position of the directory in the icon_path
+ */
+static void icon_path_index_add_folder(const char *folder, int position)
+{
+        GFile *file = g_file_new_for_path(folder);
+        GFileMonitor *monitor = g_file_monitor_directory(file, G_FILE_MONITOR_WATCH_MOVES, NULL, NULL);
+        g_object_unref(file);
+
+        if (monitor) {
+                g_signal_connect(monitor, "changed", G_CALLBACK(icon_path_index_changed), NULL);
+                g_ptr_array_add(icon_path_monitors, monitor);
+        }
+
+        GDir *dir = g_dir_open(folder, 0, NULL);
+        if (!dir)
+                return;
+
+        const char *filename;
+        while ((filename = g_dir_read_name(dir))) {
+                for (int suf = 0; icon_suffixes[suf]; suf++) {
+                        if (!g_str_has_suffix(filename, icon_suffixes[suf]))
+                                continue;
+
+                        int priority = position * G_N_ELEMENTS(icon_suffixes) + suf;
+                        char *name = g_strndup(filename, strlen(filename) - strlen(icon_suffixes[suf]));
+                        struct icon_path_entry *entry = g_hash_table_lookup(icon_path_index, name);
+
+                        if (!entry || entry->priority > priority) {
+                                entry = g_malloc(sizeof(struct icon_path_entry));
+                                entry->path = g_build_filename(folder, filename, NULL);
+                                entry->priority = priority;
+                                g_hash_table_replace(icon_path_index, name, entry);
+                        } else {
+                                g_free(name);
+                        }
+                        break;
+                }
+        }
+
+        g_dir_close(dir);
+}
+
+/**
+ * Look up an icon name in the index of all icon_path directories.
+ *
+ * The index gets (re)built, if the icon_path setting or the contents of
+ * its directories changed since the last lookup.
+ *
+ * @return a newly allocated string with the icon path
+ * @retval NULL: The icon is not in the index
+ */
+static char *icon_path_index_lookup(const char *iconname)
+{
+        if (!icon_path_index || icon_path_index_dirty
+            || !STR_EQ(icon_path_indexed, settings.icon_path)) {
+                icon_path_index_clear();
+                icon_path_index_dirty = false;
+
+                icon_path_index = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, icon_path_entry_free);
+                icon_path_monitors = g_ptr_array_new_with_free_func(g_object_unref);
+                icon_path_indexed = g_strdup(settings.icon_path);
+
+                char **folders = g_strsplit(settings.icon_path, ":", -1);
+                for (int i = 0; folders[i]; i++)
+                        icon_path_index_add_folder(folders[i], i);
+                g_strfreev(folders);
+
+                LOG_D("Indexed %u icons in the icon_path", g_hash_table_size(icon_path_index));
+        }
+
+        struct icon_path_entry *entry = g_hash_table_lookup(icon_path_index, iconname);
+        if (entry && is_readable_file(entry->path))
+                return g_strdup(entry->path);
+
+        return NULL;
+}
+
+/**
+ * Search all directories of the icon_path for an icon.
+ *
+ * @return a newly allocated string with the icon path
+ * @retval NULL: The icon is in none of the directories
+ */
+static char *icon_path_scan(const char *iconname)
+{
+        char *start = settings.icon_path,
+             *end, *current_folder, *maybe_icon_path;
+        char *new_name = NULL;
+
+        do {
+                end = strchr(start, ':');
+                if (!end) end = strchr(settings.icon_path, '\0'); /* end = end of string */
+
+                current_folder = g_strndup(start, end - start);
+
+                for (const char **suf = icon_suffixes; *suf; suf++) {
+                        gchar *name_with_extension = g_strconcat(iconname, *suf, NULL);
+                        maybe_icon_path = g_build_filename(current_folder, name_with_extension, NULL);
+                        if (is_readable_file(maybe_icon_path)) {
+                                new_name = g_strdup(maybe_icon_path);
+                        }
+                        g_free(name_with_extension);
+                        g_free(maybe_icon_path);
+
+                        if (new_name)
+                                break;
+                }
+
+                g_free(current_folder);
+                if (new_name)
+                        break;
+
+                start = end + 1;
+        } while (STR_FULL(end));
+
+        return new_name;
 }
 
 char *get_path_from_icon_name(const char *iconname)
@@ -200,7 +982,6 @@ char *get_path_from_icon_name(const char *iconname)
         if (STR_EMPTY(iconname))
                 return NULL;
 
-        const char *suffixes[] = { ".svg", ".svgz", ".png", ".xpm", NULL };
         gchar *uri_path = NULL;
         char *new_name = NULL;
 
@@ -214,34 +995,11 @@ char *get_path_from_icon_name(const char *iconname)
         if (iconname[0] == '/' || iconname[0] == '~') {
                 new_name = g_strdup(iconname);
         } else {
-        /* search in icon_path */
-                char *start = settings.icon_path,
-                     *end, *current_folder, *maybe_icon_path;
-                do {
-                        end = strchr(start, ':');
-                        if (!end) end = strchr(settings.icon_path, '\0'); /* end = end of string */
-
-                        current_folder = g_strndup(start, end - start);
-
-                        for (const char **suf = suffixes; *suf; suf++) {
-                                gchar *name_with_extension = g_strconcat(iconname, *suf, NULL);
-                                maybe_icon_path = g_build_filename(current_folder, name_with_extension, NULL);
-                                if (is_readable_file(maybe_icon_path)) {
-                                        new_name = g_strdup(maybe_icon_path);
-                                }
-                                g_free(name_with_extension);
-                                g_free(maybe_icon_path);
-
-                                if (new_name)
-                                        break;
-                        }
-
-                        g_free(current_folder);
-                        if (new_name)
-                                break;
-
-                        start = end + 1;
-                } while (STR_FULL(end));
+                new_name = icon_theme_lookup(iconname, settings.min_icon_size, settings.max_icon_size);
+                if (!new_name)
+                        new_name = icon_path_index_lookup(iconname);
+                if (!new_name)
+                        new_name = icon_path_scan(iconname);
                 if (!new_name)
                         LOG_W("No icon found in path: '%s'", iconname);
         }
@@ -250,21 +1008,165 @@ char *get_path_from_icon_name(const char *iconname)
         return new_name;
 }
 
+/**
+ * Get the modification time of a file.
+ *
+ * @return the modification time in nanoseconds
+ * @retval -1: The file can't be accessed
+ */
+static gint64 icon_file_mtime(const char *path)
+{
+        struct stat st;
+
+        if (stat(path, &st) != 0)
+                return -1;
+
+        return (gint64)st.st_mtim.tv_sec * G_GINT64_CONSTANT(1000000000) + st.st_mtim.tv_nsec;
+}
+
+static void icon_cache_entry_free(gpointer data)
+{
+        struct icon_cache_entry *entry = data;
+
+        g_queue_unlink(&icon_cache_lru, &entry->lru);
+        icon_cache_used -= entry->size;
+
+        g_object_unref(entry->pixbuf);
+        g_free(entry->path);
+        g_free(entry->key);
+        g_free(entry);
+}
+
+/**
+ * Build the key of an icon in #icon_cache. As icons get scaled while
+ * decoding, the key has to contain the current icon size limits.
+ */
+static char *icon_cache_key(const char *iconname)
+{
+        return g_strdup_printf("%d:%d:%s", settings.min_icon_size, settings.max_icon_size, iconname);
+}
+
+/**
+ * Look up a decoded icon and mark it as recently used.
+ *
+ * Entries, whose file changed since decoding, get dropped.
+ *
+ * @return the cache entry or NULL if there is no valid one
+ */
+static struct icon_cache_entry *icon_cache_lookup(const char *key)
+{
+        struct icon_cache_entry *entry = icon_cache ? g_hash_table_lookup(icon_cache, key) : NULL;
+
+        if (entry && entry->path && icon_file_mtime(entry->path) != entry->mtime) {
+                LOG_D("Icon file '%s' changed, decoding it again", entry->path);
+                g_hash_table_remove(icon_cache, key);
+                entry = NULL;
+        }
+
+        if (!entry) {
+                icon_cache_stats.misses++;
+                return NULL;
+        }
+
+        icon_cache_stats.hits++;
+        g_queue_unlink(&icon_cache_lru, &entry->lru);
+        g_queue_push_head_link(&icon_cache_lru, &entry->lru);
+
+        return entry;
+}
+
+/**
+ * Add a decoded icon to the cache. The least recently used icons get
+ * evicted until the icon fits into settings.icon_cache_size.
+ *
+ * @param key The key from icon_cache_key(). Takes ownership.
+ * @param path (nullable) The expanded path of the icon file, NULL if the
+ *             icon was sent as raw data. Takes ownership.
+ * @param pixbuf The decoded icon. Adds a new reference.
+ */
+static void icon_cache_insert(char *key, char *path, GdkPixbuf *pixbuf)
+{
+        gsize budget = (gsize)MAX(settings.icon_cache_size, 0) * 1024;
+        gsize size = gdk_pixbuf_get_byte_length(pixbuf);
+        cairo_surface_t *surface = g_object_get_data(G_OBJECT(pixbuf), icon_pixbuf_surface_key);
+        if (surface)
+                size += (gsize)cairo_image_surface_get_stride(surface)
+                      * cairo_image_surface_get_height(surface);
+        gint64 mtime = path ? icon_file_mtime(path) : 0;
+
+        if (size > budget || mtime < 0) {
+                g_free(key);
+                g_free(path);
+                return;
+        }
+
+        if (!icon_cache)
+                icon_cache = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, icon_cache_entry_free);
+
+        while (icon_cache_used + size > budget) {
+                struct icon_cache_entry *oldest = g_queue_peek_tail(&icon_cache_lru);
+                g_hash_table_remove(icon_cache, oldest->key);
+        }
+
+        struct icon_cache_entry *entry = g_malloc0(sizeof(struct icon_cache_entry));
+        entry->key = key;
+        entry->path = path;
+        entry->mtime = mtime;
+        entry->pixbuf = g_object_ref(pixbuf);
+        entry->size = size;
+        entry->lru.data = entry;
+
+        g_hash_table_replace(icon_cache, key, entry);
+        g_queue_push_head_link(&icon_cache_lru, &entry->lru);
+        icon_cache_used += size;
+}
+
+/* see icon.h */
+void icon_cache_clear(void)
+{
+        g_clear_pointer(&icon_cache, g_hash_table_unref);
+}
+
+/* see icon.h */
+struct icon_cache_stats icon_cache_stats_get(void)
+{
+        return icon_cache_stats;
+}
+
 GdkPixbuf *get_pixbuf_from_icon(const char *iconname)
 {
+        bool use_cache = settings.icon_cache_size > 0;
+        char *key = NULL;
+
+        if (use_cache) {
+                key = icon_cache_key(iconname);
+                struct icon_cache_entry *entry = icon_cache_lookup(key);
+                if (entry) {
+                        g_free(key);
+                        return g_object_ref(entry->pixbuf);
+                }
+        }
+
         char *path = get_path_from_icon_name(iconname);
         if (!path) {
+                g_free(key);
                 return NULL;
         }
 
         GdkPixbuf *pixbuf = NULL;
 
         pixbuf = get_pixbuf_from_file(path);
-        g_free(path);
 
         if (!pixbuf)
                 LOG_W("No icon found in path: '%s'", iconname);
 
+        if (pixbuf && use_cache)
+                icon_cache_insert(key, string_to_path(path), pixbuf);
+        else {
+                g_free(key);
+                g_free(path);
+        }
+
         return pixbuf;
 }
 
@@ -279,6 +1181,275 @@ GdkPixbuf *icon_get_for_name(const char *name, char **id)
         return pb;
 }
 
+static void icon_load_free(gpointer data)
+{
+        struct icon_load *load = data;
+        struct icon_load_waiter *waiter;
+
+        while ((waiter = g_queue_pop_head(&load->waiters))) {
+                if (waiter->destroy)
+                        waiter->destroy(waiter->data);
+                g_free(waiter);
+        }
+
+        if (load->pixbuf)
+                g_object_unref(load->pixbuf);
+        g_free(load->path);
+        g_free(load->name);
+        g_free(load->key);
+        g_free(load);
+}
+
+/**
+ * Hand a decoded icon over to its waiters. Runs in the main loop.
+ *
+ * @param data The finished struct icon_load
+ */
+static gboolean icon_load_finish(gpointer data)
+{
+        struct icon_load *load = data;
+        struct icon_load_waiter *waiter;
+
+        /* Steal it first, so waiters requesting the icon again don't
+         * join this load, which is already done */
+        g_hash_table_steal(icon_loads, load->key);
+
+        if (!load->pixbuf)
+                LOG_W("No icon found in path: '%s'", load->name);
+        else if (settings.icon_cache_size > 0)
+                icon_cache_insert(g_strdup(load->key),
+                                  string_to_path(g_strdup(load->path)),
+                                  load->pixbuf);
+
+        while ((waiter = g_queue_pop_head(&load->waiters))) {
+                waiter->callback(load->pixbuf, load->name, waiter->data);
+                if (waiter->destroy)
+                        waiter->destroy(waiter->data);
+                g_free(waiter);
+        }
+
+        icon_load_free(load);
+
+        return G_SOURCE_REMOVE;
+}
+
+/**
+ * Decode an icon file. Runs in the threads of #icon_loader.
+ *
+ * @param data The struct icon_load to decode
+ * @param user_data unused
+ */
+static void icon_load_run(gpointer data, gpointer user_data)
+{
+        struct icon_load *load = data;
+
+        load->pixbuf = get_pixbuf_from_file(load->path);
+
+        g_idle_add(icon_load_finish, load);
+}
+
+/* see icon.h */
+void icon_loader_init(void)
+{
+        ASSERT_OR_RET(!icon_loader,);
+
+        GError *error = NULL;
+        icon_loader = g_thread_pool_new(icon_load_run,
+                                        NULL,
+                                        MIN(4, g_get_num_processors()),
+                                        FALSE,
+                                        &error);
+        if (!icon_loader) {
+                LOG_W("Cannot start icon loader threads, decoding icons synchronously: %s",
+                      error->message);
+                g_error_free(error);
+                return;
+        }
+
+        icon_loads = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, icon_load_free);
+}
+
+/**
+ * Stop the worker threads and drop all pending loads without
+ * notifying their waiters.
+ */
+static void icon_loader_teardown(void)
+{
+        if (!icon_loader)
+                return;
+
+        /* Let the running and queued decodes finish, so that every load
+         * has its icon_load_finish() source scheduled */
+        g_thread_pool_free(icon_loader, FALSE, TRUE);
+        icon_loader = NULL;
+
+        GHashTableIter iter;
+        gpointer load;
+        g_hash_table_iter_init(&iter, icon_loads);
+        while (g_hash_table_iter_next(&iter, NULL, &load))
+                g_source_remove_by_user_data(load);
+
+        g_clear_pointer(&icon_loads, g_hash_table_unref);
+}
+
+/* see icon.h */
+GdkPixbuf *icon_get_for_name_async(const char *name,
+                                   char **id,
+                                   icon_loaded_cb callback,
+                                   gpointer data,
+                                   GDestroyNotify destroy)
+{
+        ASSERT_OR_RET(name, NULL);
+        ASSERT_OR_RET(id, NULL);
+        ASSERT_OR_RET(callback, NULL);
+
+        GdkPixbuf *pixbuf = NULL;
+
+        if (!icon_loader) {
+                pixbuf = icon_get_for_name(name, id);
+                if (destroy)
+                        destroy(data);
+                return pixbuf;
+        }
+
+        char *key = icon_cache_key(name);
+        struct icon_load *load = g_hash_table_lookup(icon_loads, key);
+
+        if (!load) {
+                struct icon_cache_entry *entry = NULL;
+                char *path = NULL;
+
+                if (settings.icon_cache_size > 0)
+                        entry = icon_cache_lookup(key);
+                if (entry)
+                        pixbuf = g_object_ref(entry->pixbuf);
+                else
+                        path = get_path_from_icon_name(name);
+
+                if (!path) {
+                        if (pixbuf)
+                                *id = g_strdup(name);
+                        g_free(key);
+                        if (destroy)
+                                destroy(data);
+                        return pixbuf;
+                }
+
+                load = g_malloc0(sizeof(struct icon_load));
+                load->key = key;
+                load->name = g_strdup(name);
+                load->path = path;
+                g_queue_init(&load->waiters);
+
+                g_hash_table_insert(icon_loads, load->key, load);
+                g_thread_pool_push(icon_loader, load, NULL);
+        } else {
+                LOG_D("Icon '%s' is already getting decoded", name);
+                g_free(key);
+        }
+
+        struct icon_load_waiter *waiter = g_malloc(sizeof(struct icon_load_waiter));
+        waiter->callback = callback;
+        waiter->data = data;
+        waiter->destroy = destroy;
+        g_queue_push_tail(&load->waiters, waiter);
+
+        *id = g_strdup(name);
+        return NULL;
+}
+
+/* see icon.h */
+void icon_teardown(void)
+{
+        icon_loader_teardown();
+        icon_cache_clear();
+        icon_path_index_clear();
+        icon_theme_teardown();
+}
+
+#define ICON_HASH_PRIME1 G_GUINT64_CONSTANT(0x9E3779B185EBCA87)
+#define ICON_HASH_PRIME2 G_GUINT64_CONSTANT(0xC2B2AE3D27D4EB4F)
+#define ICON_HASH_PRIME3 G_GUINT64_CONSTANT(0x165667B19E3779F9)
+
+static inline guint64 icon_hash_round(guint64 acc, guint64 input)
+{
+        acc += input * ICON_HASH_PRIME2;
+        acc = (acc << 31) | (acc >> 33);
+        return acc * ICON_HASH_PRIME1;
+}
+
+static inline guint64 icon_hash_read64(const unsigned char *p)
+{
+        guint64 v;
+        memcpy(&v, p, sizeof(v));
+        return GUINT64_FROM_LE(v);
+}
+
+/**
+ * Hash the pixels of a raw image without the spacers at the row ends.
+ *
+ * The rows get hashed in place with the round function of xxHash64 on four
+ * independent lanes, which is not cryptographically secure, but an order
+ * of magnitude faster than MD5.
+ *
+ * @param pixels The first row of the image
+ * @param row_len The amount of bytes to hash in every row
+ * @param rowstride The distance between two rows in bytes
+ * @param height The amount of rows
+ * @param seed A value to mix into the hash, e.g. the image dimensions
+ */
+static guint64 icon_data_hash(const unsigned char *pixels,
+                              size_t row_len,
+                              size_t rowstride,
+                              int height,
+                              guint64 seed)
+{
+        guint64 lane[4] = {
+                seed + ICON_HASH_PRIME1 + ICON_HASH_PRIME2,
+                seed + ICON_HASH_PRIME2,
+                seed,
+                seed - ICON_HASH_PRIME1,
+        };
+
+        for (int y = 0; y < height; y++) {
+                const unsigned char *p = pixels + y * rowstride;
+                size_t i = 0;
+
+                for (; i + 32 <= row_len; i += 32) {
+                        lane[0] = icon_hash_round(lane[0], icon_hash_read64(p + i));
+                        lane[1] = icon_hash_round(lane[1], icon_hash_read64(p + i + 8));
+                        lane[2] = icon_hash_round(lane[2], icon_hash_read64(p + i + 16));
+                        lane[3] = icon_hash_round(lane[3], icon_hash_read64(p + i + 24));
+                }
+
+                /* The row's tail is the same length in every row, so
+                 * distributing it onto the lanes is still deterministic */
+                int l = 0;
+                for (; i + 8 <= row_len; i += 8, l++)
+                        lane[l] = icon_hash_round(lane[l], icon_hash_read64(p + i));
+
+                if (i < row_len) {
+                        unsigned char tail[8] = { 0 };
+                        memcpy(tail, p + i, row_len - i);
+                        lane[l] = icon_hash_round(lane[l], icon_hash_read64(tail));
+                }
+        }
+
+        guint64 h = ((lane[0] << 1) | (lane[0] >> 63))
+                  + ((lane[1] << 7) | (lane[1] >> 57))
+                  + ((lane[2] << 12) | (lane[2] >> 52))
+                  + ((lane[3] << 18) | (lane[3] >> 46));
+        h += (guint64)row_len * height;
+
+        h ^= h >> 33;
+        h *= ICON_HASH_PRIME2;
+        h ^= h >> 29;
+        h *= ICON_HASH_PRIME3;
+        h ^= h >> 32;
+
+        return h;
+}
+
 GdkPixbuf *icon_get_for_data(GVariant *data, char **id)
 {
         ASSERT_OR_RET(data, NULL);
@@ -310,7 +1481,6 @@ GdkPixbuf *icon_get_for_data(GVariant *data, char **id)
 
         GdkPixbuf *pixbuf = NULL;
         GVariant *data_variant = NULL;
-        unsigned char *data_pb;
 
         gsize len_expected;
         gsize len_actual;
@@ -347,43 +1517,75 @@ GdkPixbuf *icon_get_for_data(GVariant *data, char **id)
                 return NULL;
         }
 
-        data_pb = (guchar *) g_memdup(g_variant_get_data(data_variant), len_actual);
+        /* The same bytes form a different image in another format */
+        guint64 format = icon_hash_round((guint64)width << 32 | (guint32)height,
+                                         (guint64)n_channels << 16 | bits_per_sample << 8 | !!has_alpha);
+        guint64 hash = icon_data_hash(g_variant_get_data(data_variant),
+                                      width * pixelstride,
+                                      rowstride,
+                                      height,
+                                      format);
+        char *data_id = g_strdup_printf("%016" G_GINT64_MODIFIER "x", hash);
+
+        bool use_cache = settings.icon_cache_size > 0;
+        char *key = NULL;
+
+        /* The same image gets sent over and over again by most clients,
+         * so share the decoded pixbuf */
+        if (use_cache) {
+                key = icon_cache_key(data_id);
+                struct icon_cache_entry *entry = icon_cache_lookup(key);
+                if (entry) {
+                        g_free(key);
+                        g_variant_unref(data_variant);
+                        *id = data_id;
+                        return g_object_ref(entry->pixbuf);
+                }
+        }
+
+        /* The pixbuf references the memory of the GVariant instead of
+         * copying it, scaling or caching it copies it anyway */
+        GBytes *bytes = g_variant_get_data_as_bytes(data_variant);
+        pixbuf = gdk_pixbuf_new_from_bytes(bytes,
+                                           GDK_COLORSPACE_RGB,
+                                           has_alpha,
+                                           bits_per_sample,
+                                           width,
+                                           height,
+                                           rowstride);
+        g_bytes_unref(bytes);
+        g_variant_unref(data_variant);
 
-        pixbuf = gdk_pixbuf_new_from_data(data_pb,
-                                          GDK_COLORSPACE_RGB,
-                                          has_alpha,
-                                          bits_per_sample,
-                                          width,
-                                          height,
-                                          rowstride,
-                                          (GdkPixbufDestroyNotify) g_free,
-                                          data_pb);
         if (!pixbuf) {
                 /* Dear user, I'm sorry, I'd like to give you a more specific
                  * error message. But sadly, I can't */
                 LOG_W("Cannot serialise raw icon data into pixbuf.");
+                g_free(key);
+                g_free(data_id);
                 return NULL;
         }
 
-        /* To calculate a checksum of the current image, we have to remove
-         * all excess spacers, so that our checksummed memory only contains
-         * real data. */
-        size_t data_chk_len = pixelstride * width * height;
-        unsigned char *data_chk = g_malloc(data_chk_len);
-        size_t rowstride_short = pixelstride * width;
+        GdkPixbuf *wrapped = pixbuf;
+        pixbuf = icon_pixbuf_prepare(pixbuf);
 
-        for (int i = 0; i < height; i++) {
-                memcpy(data_chk + (i*rowstride_short),
-                       data_pb  + (i*rowstride),
-                       rowstride_short);
+        /* An unscaled pixbuf still wraps the message, which must not
+         * stay alive as long as the icon is cached */
+        if (use_cache && pixbuf == wrapped) {
+                GdkPixbuf *copy = gdk_pixbuf_copy(pixbuf);
+                if (copy) {
+                        g_object_set_data_full(G_OBJECT(copy),
+                                               icon_pixbuf_surface_key,
+                                               g_object_steal_data(G_OBJECT(pixbuf), icon_pixbuf_surface_key),
+                                               (GDestroyNotify) cairo_surface_destroy);
+                        g_object_unref(pixbuf);
+                        pixbuf = copy;
+                }
         }
 
-        *id = g_compute_checksum_for_data(G_CHECKSUM_MD5, data_chk, data_chk_len);
-
-        g_free(data_chk);
-        g_variant_unref(data_variant);
+        if (use_cache)
+                icon_cache_insert(key, NULL, pixbuf);
 
-        pixbuf = icon_pixbuf_scale(pixbuf);
+        *id = data_id;
 
         return pixbuf;
 }
@@ -8,7 +8,29 @@
 
 cairo_surface_t *gdk_pixbuf_to_cairo_surface(GdkPixbuf *pixbuf);
 
+/** Convert a pixbuf into a cairo surface, which is shared between all
+ * icons with the same id.
+ *
+ * The pixbufs of get_pixbuf_from_file() and friends carry the surface
+ * prepared alongside the scaling, so they don't get converted again.
+ * Others, e.g. after the icon size limits changed, get downscaled with a
+ * box filter while converting. Surfaces are shared per id and size, the
+ * conversion only happens, if there is no surface for the given id and
+ * size yet.
+ *
+ * @param pixbuf The pixbuf to convert
+ * @param id     (nullable) The unique identifier of the pixbuf as returned by
+ *               icon_get_for_name() or icon_get_for_data(). If NULL, the
+ *               surface won't get shared.
+ * @return a new reference to the surface
+ * @retval NULL: The conversion failed
+ */
+cairo_surface_t *icon_get_surface(GdkPixbuf *pixbuf, const char *id);
+
 /** Retrieve an icon by its full filepath, scaled according to settings.
+ *
+ * Raster images bigger than settings.max_icon_size get downscaled with a
+ * box filter, so only the icon sized result gets kept.
  *
  * @param filename A string representing a readable file path
  *
@@ -18,6 +40,11 @@ cairo_surface_t *gdk_pixbuf_to_cairo_surface(GdkPixbuf *pixbuf);
 GdkPixbuf *get_pixbuf_from_file(const char *filename);
 
 /** Retrieve a path from an icon name.
+ *
+ * Icon names are looked up in settings.icon_theme first. Afterwards in an
+ * index of the settings.icon_path directories, which gets refreshed when
+ * the directories change. Only if the index has no match, the directories
+ * get searched.
  *
  * @param iconname A string describing a `file://` URL, an arbitary filename
  *                 or an icon name, which then gets searched for in the
@@ -29,6 +56,9 @@ GdkPixbuf *get_pixbuf_from_file(const char *filename);
 char *get_path_from_icon_name(const char *iconname);
 
 /** Retrieve an icon by its name sent via the notification bus, scaled according to settings
+ *
+ * Decoded icons are kept in a cache limited to settings.icon_cache_size
+ * kilobytes. Files changed on disk get decoded again.
  *
  * @param iconname A string describing a `file://` URL, an arbitary filename
  *                 or an icon name, which then gets searched for in the
@@ -39,6 +69,28 @@ char *get_path_from_icon_name(const char *iconname);
  */
 GdkPixbuf *get_pixbuf_from_icon(const char *iconname);
 
+//!< Counters of the lookups in the cache of decoded icons
+struct icon_cache_stats {
+        guint64 hits;   //!< Lookups served from the cache
+        guint64 misses; //!< Lookups, which had to decode the icon
+};
+
+/**
+ * Get the current counters of the icon cache
+ */
+struct icon_cache_stats icon_cache_stats_get(void);
+
+/**
+ * Drop all decoded icons from the icon cache
+ */
+void icon_cache_clear(void);
+
+/**
+ * Stop the icon loader threads and free all cached icons, the index of
+ * the icon_path and the icon themes
+ */
+void icon_teardown(void);
+
 /** Read an icon from disk and convert it to a GdkPixbuf, scaled according to settings
  *
  * The returned id will be a unique identifier. To check if two given
@@ -54,11 +106,56 @@ GdkPixbuf *get_pixbuf_from_icon(const char *iconname);
  */
 GdkPixbuf *icon_get_for_name(const char *name, char **id);
 
+/**
+ * Called in the main loop, once an icon requested with
+ * icon_get_for_name_async() got decoded.
+ *
+ * @param pixbuf (nullable) The decoded icon, NULL if decoding failed.
+ *               The reference stays with the caller.
+ * @param id     The unique identifier of the icon, as set by
+ *               icon_get_for_name_async()
+ * @param data   The data given to icon_get_for_name_async()
+ */
+typedef void (*icon_loaded_cb)(GdkPixbuf *pixbuf, const char *id, gpointer data);
+
+/**
+ * Start the worker threads, which decode icon files for
+ * icon_get_for_name_async(). Without calling this function, all icons get
+ * decoded synchronously.
+ */
+void icon_loader_init(void);
+
+/** Like icon_get_for_name(), but decode the icon file off the main loop
+ *
+ * Cached icons are returned immediately. Otherwise the file gets decoded
+ * by the icon loader threads and @p callback is called once it is done.
+ * Concurrent requests for the same icon share a single decode.
+ *
+ * @param name     A string describing an icon, see icon_get_for_name()
+ * @param id       (necessary) A unique identifier of the icon. Filled, if
+ *                 the icon is returned or if it is getting decoded.
+ * @param callback The function to call with the decoded icon
+ * @param data     The data to pass to @p callback
+ * @param destroy  (nullable) Called with @p data, when it isn't needed
+ *                 anymore
+ * @return an instance of `GdkPixbuf`, if the icon is available right away
+ * @retval NULL: The icon is getting decoded, if @p id is set. Otherwise the
+ *               icon was not found.
+ */
+GdkPixbuf *icon_get_for_name_async(const char *name,
+                                   char **id,
+                                   icon_loaded_cb callback,
+                                   gpointer data,
+                                   GDestroyNotify destroy);
+
 /** Convert a GVariant like described in GdkPixbuf, scaled according to settings
  *
  * The returned id will be a unique identifier. To check if two given
  * GdkPixbufs are equal, it's sufficient to just compare the id strings.
  *
+ * The pixbuf shares the memory of the GVariant, unless it had to be scaled.
+ * Identical images are served from the cache of decoded icons.
+ *
  * @param data A GVariant in the format "(iiibii@ay)" filled with values
  *             like described in the notification spec.
  * @param id   (necessary) A unique identifier of the returned pixbuf.
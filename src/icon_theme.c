@@ -0,0 +1,535 @@
+#include "icon_theme.h"
+
+#include <glib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "log.h"
+#include "settings.h"
+#include "utils.h"
+
+/* Flags of an image in an icon-theme.cache */
+#define CACHE_HAS_SUFFIX_XPM (1 << 0)
+#define CACHE_HAS_SUFFIX_SVG (1 << 1)
+#define CACHE_HAS_SUFFIX_PNG (1 << 2)
+
+/** An offset in an icon-theme.cache, which points nowhere */
+#define CACHE_NONE 0xffffffff
+
+/** The size to look for, if neither min_icon_size nor max_icon_size is set */
+#define ICON_THEME_DEFAULT_SIZE 32
+
+/** A directory of an icon theme as described by its index.theme */
+struct theme_dir {
+        char *name;
+        int min_size;           /**< The smallest size the icons are suitable for */
+        int max_size;           /**< The largest size the icons are suitable for */
+};
+
+/** The icon-theme.cache of a theme in one of the base directories */
+struct theme_cache {
+        char *path;             /**< The theme directory containing the cache */
+        GMappedFile *file;
+        const char *data;
+        gsize length;
+        guint32 hash;           /**< Offset of the hash table */
+        guint32 n_dirs;
+        struct theme_dir **dirs; /**< The index.theme entries of all directories in the cache (nullable) */
+};
+
+struct theme {
+        char *name;
+        char **inherits;
+        GHashTable *dirs;       /**< All directories from index.theme: char* -> struct theme_dir* */
+        GPtrArray *caches;      /**< All caches of the theme */
+};
+
+/** The best image of an icon found so far */
+struct theme_match {
+        const struct theme_cache *cache;
+        const struct theme_dir *dir;
+        guint16 flags;
+        int distance;           /**< Distance between the wanted size and the sizes of #dir */
+};
+
+/** The themes to search in, in the order to search */
+static GPtrArray *themes = NULL;
+/** The value of settings.icon_theme, when #themes got loaded */
+static char *themes_loaded = NULL;
+
+static bool cache_read16(const struct theme_cache *cache, guint32 offset, guint16 *value)
+{
+        guint16 raw;
+
+        if (offset > cache->length || cache->length - offset < sizeof(raw))
+                return false;
+
+        memcpy(&raw, cache->data + offset, sizeof(raw));
+        *value = GUINT16_FROM_BE(raw);
+        return true;
+}
+
+static bool cache_read32(const struct theme_cache *cache, guint32 offset, guint32 *value)
+{
+        guint32 raw;
+
+        if (offset > cache->length || cache->length - offset < sizeof(raw))
+                return false;
+
+        memcpy(&raw, cache->data + offset, sizeof(raw));
+        *value = GUINT32_FROM_BE(raw);
+        return true;
+}
+
+/**
+ * Get a string from the cache.
+ *
+ * @retval NULL: The offset or the string exceed the file
+ */
+static const char *cache_string(const struct theme_cache *cache, guint32 offset)
+{
+        if (offset >= cache->length)
+                return NULL;
+        if (!memchr(cache->data + offset, '\0', cache->length - offset))
+                return NULL;
+
+        return cache->data + offset;
+}
+
+/**
+ * The hash function for icon names used by icon-theme.cache files
+ */
+static guint32 icon_name_hash(const char *name)
+{
+        const signed char *p = (const signed char *)name;
+        guint32 h = *p;
+
+        if (h)
+                for (p += 1; *p != '\0'; p++)
+                        h = (h << 5) - h + *p;
+
+        return h;
+}
+
+static void theme_dir_free(gpointer data)
+{
+        struct theme_dir *dir = data;
+
+        g_free(dir->name);
+        g_free(dir);
+}
+
+static void theme_cache_free(gpointer data)
+{
+        struct theme_cache *cache = data;
+
+        g_mapped_file_unref(cache->file);
+        g_free(cache->dirs);
+        g_free(cache->path);
+        g_free(cache);
+}
+
+static void theme_free(gpointer data)
+{
+        struct theme *theme = data;
+
+        g_ptr_array_unref(theme->caches);
+        g_hash_table_unref(theme->dirs);
+        g_strfreev(theme->inherits);
+        g_free(theme->name);
+        g_free(theme);
+}
+
+static int key_file_get_int(GKeyFile *file, const char *group, const char *key, int fallback)
+{
+        GError *error = NULL;
+        int value = g_key_file_get_integer(file, group, key, &error);
+
+        if (error) {
+                g_error_free(error);
+                return fallback;
+        }
+        return value;
+}
+
+/**
+ * Read the description of a directory from an index.theme.
+ *
+ * @retval NULL: The directory is not described or is meant for HiDPI only
+ */
+static struct theme_dir *theme_dir_new(GKeyFile *index, const char *name)
+{
+        int size = key_file_get_int(index, name, "Size", 0);
+
+        if (size <= 0 || key_file_get_int(index, name, "Scale", 1) != 1)
+                return NULL;
+
+        struct theme_dir *dir = g_malloc(sizeof(struct theme_dir));
+        char *type = g_key_file_get_string(index, name, "Type", NULL);
+
+        dir->name = g_strdup(name);
+
+        if (STR_EQ(type, "Fixed")) {
+                dir->min_size = size;
+                dir->max_size = size;
+        } else if (STR_EQ(type, "Scalable")) {
+                dir->min_size = key_file_get_int(index, name, "MinSize", size);
+                dir->max_size = key_file_get_int(index, name, "MaxSize", size);
+        } else {
+                int threshold = key_file_get_int(index, name, "Threshold", 2);
+                dir->min_size = size - threshold;
+                dir->max_size = size + threshold;
+        }
+
+        g_free(type);
+        return dir;
+}
+
+/**
+ * Check if a theme directory has an icon-theme.cache, which is up to date.
+ *
+ * Like GTK, caches older than the theme directory are considered outdated.
+ */
+static bool theme_cache_is_current(const char *path, const char *cache_path)
+{
+        struct stat dir_st, cache_st;
+
+        if (stat(path, &dir_st) != 0)
+                return false;
+
+        if (stat(cache_path, &cache_st) != 0) {
+                LOG_I("Icon theme directory '%s' has no icon-theme.cache, ignoring it", path);
+                return false;
+        }
+
+        if (cache_st.st_mtime < dir_st.st_mtime) {
+                LOG_I("The icon-theme.cache in '%s' is outdated, ignoring it", path);
+                return false;
+        }
+
+        return true;
+}
+
+/**
+ * Read the header and the directory list of a mapped cache.
+ *
+ * @return if the cache is valid
+ */
+static bool theme_cache_parse(struct theme_cache *cache, const struct theme *theme)
+{
+        guint16 major;
+        guint32 dir_list;
+
+        if (!cache_read16(cache, 0, &major) || major != 1
+            || !cache_read32(cache, 4, &cache->hash)
+            || !cache_read32(cache, 8, &dir_list)
+            || !cache_read32(cache, dir_list, &cache->n_dirs)
+            || cache->n_dirs > (cache->length - dir_list) / 4)
+                return false;
+
+        cache->dirs = g_malloc0_n(cache->n_dirs, sizeof(struct theme_dir *));
+        for (guint32 i = 0; i < cache->n_dirs; i++) {
+                guint32 offset;
+                const char *name;
+
+                if (!cache_read32(cache, dir_list + 4 + 4 * i, &offset)
+                    || !(name = cache_string(cache, offset)))
+                        return false;
+
+                cache->dirs[i] = g_hash_table_lookup(theme->dirs, name);
+        }
+
+        return true;
+}
+
+/**
+ * Map the icon-theme.cache of a theme directory.
+ *
+ * @param theme The theme the directory belongs to
+ * @param path The theme directory inside one of the base directories
+ * @retval NULL: There is no valid and up to date cache
+ */
+static struct theme_cache *theme_cache_load(const struct theme *theme, const char *path)
+{
+        char *cache_path = g_build_filename(path, "icon-theme.cache", NULL);
+        GError *error = NULL;
+
+        if (!theme_cache_is_current(path, cache_path)) {
+                g_free(cache_path);
+                return NULL;
+        }
+
+        GMappedFile *file = g_mapped_file_new(cache_path, FALSE, &error);
+        if (!file) {
+                LOG_W("Cannot map '%s': %s", cache_path, error->message);
+                g_error_free(error);
+                g_free(cache_path);
+                return NULL;
+        }
+
+        struct theme_cache *cache = g_malloc0(sizeof(struct theme_cache));
+        cache->path = g_strdup(path);
+        cache->file = file;
+        cache->data = g_mapped_file_get_contents(file);
+        cache->length = g_mapped_file_get_length(file);
+
+        if (!theme_cache_parse(cache, theme)) {
+                LOG_W("Invalid icon theme cache '%s'", cache_path);
+                g_clear_pointer(&cache, theme_cache_free);
+        }
+
+        g_free(cache_path);
+        return cache;
+}
+
+/**
+ * Load a theme from the first base directory containing its index.theme.
+ * The icons of the theme can be spread over all base directories.
+ *
+ * @retval NULL: The theme doesn't exist
+ */
+static struct theme *theme_load(const char *name, char **basedirs)
+{
+        GKeyFile *index = g_key_file_new();
+        bool found = false;
+
+        /* Lists in index.theme are separated by commas */
+        g_key_file_set_list_separator(index, ',');
+
+        for (char **basedir = basedirs; *basedir && !found; basedir++) {
+                char *path = g_build_filename(*basedir, name, "index.theme", NULL);
+                found = g_key_file_load_from_file(index, path, G_KEY_FILE_NONE, NULL);
+                g_free(path);
+        }
+
+        if (!found) {
+                g_key_file_free(index);
+                return NULL;
+        }
+
+        struct theme *theme = g_malloc0(sizeof(struct theme));
+        theme->name = g_strdup(name);
+        theme->inherits = g_key_file_get_string_list(index, "Icon Theme", "Inherits", NULL, NULL);
+        theme->dirs = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, theme_dir_free);
+        theme->caches = g_ptr_array_new_with_free_func(theme_cache_free);
+
+        char **dirs = g_key_file_get_string_list(index, "Icon Theme", "Directories", NULL, NULL);
+        for (char **d = dirs; d && *d; d++) {
+                struct theme_dir *dir = theme_dir_new(index, *d);
+                if (dir)
+                        g_hash_table_replace(theme->dirs, dir->name, dir);
+        }
+        g_strfreev(dirs);
+        g_key_file_free(index);
+
+        for (char **basedir = basedirs; *basedir; basedir++) {
+                char *path = g_build_filename(*basedir, name, NULL);
+                struct theme_cache *cache = theme_cache_load(theme, path);
+                if (cache)
+                        g_ptr_array_add(theme->caches, cache);
+                g_free(path);
+        }
+
+        return theme;
+}
+
+/**
+ * Add a theme and all themes it inherits from to #themes.
+ * Themes already in #themes are skipped.
+ */
+static void theme_load_recursive(const char *name, char **basedirs)
+{
+        for (guint i = 0; i < themes->len; i++)
+                if (STR_EQ(((struct theme *)themes->pdata[i])->name, name))
+                        return;
+
+        struct theme *theme = theme_load(name, basedirs);
+        if (!theme) {
+                LOG_I("Icon theme '%s' not found", name);
+                return;
+        }
+
+        g_ptr_array_add(themes, theme);
+        for (char **parent = theme->inherits; parent && *parent; parent++)
+                theme_load_recursive(*parent, basedirs);
+}
+
+/**
+ * Load a theme and its inherited themes. Replaces the loaded themes.
+ *
+ * @param name The name of the theme
+ * @param basedirs The directories to search for themes, NULL-terminated
+ */
+static void icon_theme_load(const char *name, char **basedirs)
+{
+        icon_theme_teardown();
+
+        themes = g_ptr_array_new_with_free_func(theme_free);
+        themes_loaded = g_strdup(name);
+
+        theme_load_recursive(name, basedirs);
+        theme_load_recursive("hicolor", basedirs);
+}
+
+/**
+ * Get the directories to search for icon themes as specified by the
+ * freedesktop icon theme specification.
+ */
+static char **icon_theme_basedirs(void)
+{
+        GPtrArray *dirs = g_ptr_array_new();
+
+        g_ptr_array_add(dirs, g_build_filename(g_get_home_dir(), ".icons", NULL));
+        g_ptr_array_add(dirs, g_build_filename(g_get_user_data_dir(), "icons", NULL));
+        for (const char * const *d = g_get_system_data_dirs(); *d; d++)
+                g_ptr_array_add(dirs, g_build_filename(*d, "icons", NULL));
+        g_ptr_array_add(dirs, NULL);
+
+        return (char **)g_ptr_array_free(dirs, FALSE);
+}
+
+/**
+ * Check if a directory fits better than the best match so far.
+ *
+ * The closest size wins, then the most specific directory. Of two equally
+ * distant sizes the larger one wins, as scaling it down looks better.
+ */
+static bool theme_match_better(const struct theme_match *best, const struct theme_dir *dir, int distance)
+{
+        if (!best->dir || distance != best->distance)
+                return !best->dir || distance < best->distance;
+
+        int span = dir->max_size - dir->min_size;
+        int best_span = best->dir->max_size - best->dir->min_size;
+        if (span != best_span)
+                return span < best_span;
+
+        return dir->max_size > best->dir->max_size;
+}
+
+/**
+ * Check the images of an icon in a cache for a better match.
+ *
+ * @param cache The cache to search
+ * @param name The name of the icon
+ * @param size The wanted size of the icon
+ * @param best The best match so far. Gets updated, if a better one is found.
+ */
+static void theme_cache_find(const struct theme_cache *cache,
+                             const char *name,
+                             int size,
+                             struct theme_match *best)
+{
+        guint32 n_buckets, icon;
+
+        if (!cache_read32(cache, cache->hash, &n_buckets) || n_buckets == 0)
+                return;
+        if (!cache_read32(cache, cache->hash + 4 + 4 * (icon_name_hash(name) % n_buckets), &icon))
+                return;
+
+        /* Every icon takes at least 12 bytes, which limits the length of
+         * a valid chain and catches loops in broken caches */
+        for (gsize max_chain = cache->length / 12; icon != CACHE_NONE; max_chain--) {
+                guint32 chain, name_offset;
+                const char *icon_name;
+
+                if (!cache_read32(cache, icon, &chain)
+                    || !cache_read32(cache, icon + 4, &name_offset)
+                    || !(icon_name = cache_string(cache, name_offset)))
+                        return;
+
+                if (STR_EQ(icon_name, name))
+                        break;
+
+                if (max_chain == 0)
+                        return;
+                icon = chain;
+        }
+        if (icon == CACHE_NONE)
+                return;
+
+        guint32 images, n_images;
+        if (!cache_read32(cache, icon + 8, &images) || !cache_read32(cache, images, &n_images))
+                return;
+
+        for (guint32 i = 0; i < n_images; i++) {
+                guint16 dir_index, flags;
+                if (!cache_read16(cache, images + 4 + 8 * i, &dir_index)
+                    || !cache_read16(cache, images + 6 + 8 * i, &flags))
+                        return;
+
+                if (dir_index >= cache->n_dirs || !cache->dirs[dir_index])
+                        continue;
+                if (!(flags & (CACHE_HAS_SUFFIX_SVG | CACHE_HAS_SUFFIX_PNG | CACHE_HAS_SUFFIX_XPM)))
+                        continue;
+
+                const struct theme_dir *dir = cache->dirs[dir_index];
+                int distance = 0;
+                if (size < dir->min_size)
+                        distance = dir->min_size - size;
+                else if (size > dir->max_size)
+                        distance = size - dir->max_size;
+
+                if (theme_match_better(best, dir, distance)) {
+                        best->cache = cache;
+                        best->dir = dir;
+                        best->flags = flags;
+                        best->distance = distance;
+                }
+        }
+}
+
+/**
+ * Search all loaded themes for an icon.
+ *
+ * @return a newly allocated path to the icon file
+ * @retval NULL: No loaded theme contains the icon
+ */
+static char *icon_theme_find(const char *name, int min_size, int max_size)
+{
+        int size = max_size ? max_size : min_size ? min_size : ICON_THEME_DEFAULT_SIZE;
+
+        for (guint t = 0; t < themes->len; t++) {
+                const struct theme *theme = themes->pdata[t];
+                struct theme_match best = { NULL, NULL, 0, 0 };
+
+                for (guint c = 0; c < theme->caches->len; c++)
+                        theme_cache_find(theme->caches->pdata[c], name, size, &best);
+
+                if (!best.dir)
+                        continue;
+
+                const char *suffix = best.flags & CACHE_HAS_SUFFIX_SVG ? ".svg"
+                                   : best.flags & CACHE_HAS_SUFFIX_PNG ? ".png"
+                                   : ".xpm";
+
+                return g_strconcat(best.cache->path, "/", best.dir->name, "/", name, suffix, NULL);
+        }
+
+        return NULL;
+}
+
+/* see icon_theme.h */
+char *icon_theme_lookup(const char *name, int min_size, int max_size)
+{
+        if (STR_EMPTY(settings.icon_theme) || STR_EMPTY(name) || strchr(name, '/'))
+                return NULL;
+
+        if (!themes || !STR_EQ(themes_loaded, settings.icon_theme)) {
+                char **basedirs = icon_theme_basedirs();
+                icon_theme_load(settings.icon_theme, basedirs);
+                g_strfreev(basedirs);
+        }
+
+        return icon_theme_find(name, min_size, max_size);
+}
+
+/* see icon_theme.h */
+void icon_theme_teardown(void)
+{
+        g_clear_pointer(&themes, g_ptr_array_unref);
+        g_clear_pointer(&themes_loaded, g_free);
+}
+
+/* vim: set ft=c tabstop=8 shiftwidth=8 expandtab textwidth=0: */
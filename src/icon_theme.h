@@ -0,0 +1,30 @@
+#ifndef DUNST_ICON_THEME_H
+#define DUNST_ICON_THEME_H
+
+/**
+ * Look up an icon name in the icon theme from settings.icon_theme.
+ *
+ * The theme, the themes it inherits from and finally the hicolor theme are
+ * searched in this order. Only themes with an up to date icon-theme.cache
+ * (as generated by gtk-update-icon-cache) are used. The cache files stay
+ * mapped into memory, so a lookup doesn't touch the filesystem.
+ *
+ * Out of all sizes of the icon in the first theme containing it, the one
+ * fitting best into the given limits is chosen.
+ *
+ * @param name The name of the icon without any suffix
+ * @param min_size The minimum size of the icon in pixels, 0 for none
+ * @param max_size The maximum size of the icon in pixels, 0 for none
+ *
+ * @return a newly allocated string with the path of the icon file
+ * @retval NULL: No theme is configured or no theme contains the icon
+ */
+char *icon_theme_lookup(const char *name, int min_size, int max_size);
+
+/**
+ * Unmap all loaded icon themes
+ */
+void icon_theme_teardown(void);
+
+#endif
+/* vim: set ft=c tabstop=8 shiftwidth=8 expandtab textwidth=0: */
@@ -12,52 +12,166 @@
 #include "settings.h"
 #include "utils.h"
 
+//!< An HTML entity and the character it stands for
+struct markup_entity {
+        const char *entity;
+        char c;
+};
+
+/** The entities, which get converted back by markup_strip() */
+static const struct markup_entity markup_entities[] = {
+        { "&quot;", '"'  },
+        { "&apos;", '\'' },
+        { "&lt;",   '<'  },
+        { "&gt;",   '>'  },
+        { "&amp;",  '&'  },
+};
+
+//!< The output of the single pass transformations
+struct markup_writer {
+        GString *out;
+        bool quote;             //!< Convert HTML special symbols to entities
+        bool fold_newlines;     //!< Convert newlines to spaces
+        char pending[8];        //!< The prefix of an entity to convert back
+        int pending_len;
+};
+
+static inline void markup_writer_init(struct markup_writer *w, gsize len, bool quote, bool fold_newlines)
+{
+        /* Leave some room for the quoted characters */
+        w->out = g_string_sized_new(len + len / 8 + 1);
+        w->quote = quote;
+        w->fold_newlines = fold_newlines;
+        w->pending_len = 0;
+}
+
 /**
- * Convert all HTML special symbols to HTML entities.
- * @param str (nullable)
+ * Append a single character to the output, quoted and folded as configured.
  */
-static char *markup_quote(char *str)
+static inline void markup_put(struct markup_writer *w, char c)
 {
-        ASSERT_OR_RET(str, NULL);
+        if (w->quote) {
+                switch (c) {
+                case '&':  g_string_append_len(w->out, "&amp;", 5); return;
+                case '"':  g_string_append_len(w->out, "&quot;", 6); return;
+                case '\'': g_string_append_len(w->out, "&apos;", 6); return;
+                case '<':  g_string_append_len(w->out, "&lt;", 4); return;
+                case '>':  g_string_append_len(w->out, "&gt;", 4); return;
+                }
+        }
+        if (c == '\n' && w->fold_newlines)
+                c = ' ';
+        g_string_append_c(w->out, c);
+}
+
+static void markup_put_unquoted(struct markup_writer *w, char c);
+
+/**
+ * Write out the pending characters, which turned out not to be an entity.
+ * The '&' gets written as is, the rest may contain the start of another
+ * entity.
+ */
+static void markup_flush_pending(struct markup_writer *w)
+{
+        char rest[sizeof(w->pending)];
+        int rest_len = w->pending_len - 1;
 
-        str = string_replace_all("&", "&amp;", str);
-        str = string_replace_all("\"", "&quot;", str);
-        str = string_replace_all("'", "&apos;", str);
-        str = string_replace_all("<", "&lt;", str);
-        str = string_replace_all(">", "&gt;", str);
+        memcpy(rest, w->pending + 1, rest_len);
+        w->pending_len = 0;
 
-        return str;
+        markup_put(w, '&');
+        for (int i = 0; i < rest_len; i++)
+                markup_put_unquoted(w, rest[i]);
 }
 
 /**
- * Convert all HTML special entities to their actual char.
- * @param str (nullable)
+ * Append a single character to the output and convert the entities in
+ * #markup_entities back to their characters on the way.
  */
-static char *markup_unquote(char *str)
+static void markup_put_unquoted(struct markup_writer *w, char c)
 {
-        ASSERT_OR_RET(str, NULL);
+        if (w->pending_len == 0 && c != '&') {
+                markup_put(w, c);
+                return;
+        }
+
+        w->pending[w->pending_len++] = c;
+
+        bool prefix = false;
+        for (int i = 0; i < G_N_ELEMENTS(markup_entities); i++) {
+                const struct markup_entity *e = &markup_entities[i];
+                if (strncmp(w->pending, e->entity, w->pending_len) != 0)
+                        continue;
+                if (e->entity[w->pending_len] == '\0') {
+                        w->pending_len = 0;
+                        markup_put(w, e->c);
+                        return;
+                }
+                prefix = true;
+        }
 
-        str = string_replace_all("&quot;", "\"", str);
-        str = string_replace_all("&apos;", "'", str);
-        str = string_replace_all("&lt;", "<", str);
-        str = string_replace_all("&gt;", ">", str);
-        str = string_replace_all("&amp;", "&", str);
+        if (!prefix)
+                markup_flush_pending(w);
+}
 
-        return str;
+static char *markup_writer_finish(struct markup_writer *w)
+{
+        while (w->pending_len > 0)
+                markup_flush_pending(w);
+        return g_string_free(w->out, FALSE);
 }
 
 /**
- * Convert all HTML linebreak tags to a newline character
- * @param str (nullable)
+ * Get the length of the HTML linebreak tag at the start of str.
+ *
+ * @return the length or 0, if str doesn't start with a linebreak tag
  */
-static char *markup_br2nl(char *str)
+static inline int markup_br_len(const char *str)
 {
-        ASSERT_OR_RET(str, NULL);
+        if (strncmp(str, "<br", 3) != 0)
+                return 0;
+        if (str[3] == '>')
+                return 4;
+        if (str[3] == '/' && str[4] == '>')
+                return 5;
+        if (str[3] == ' ' && str[4] == '/' && str[5] == '>')
+                return 6;
+        return 0;
+}
 
-        str = string_replace_all("<br>", "\n", str);
-        str = string_replace_all("<br/>", "\n", str);
-        str = string_replace_all("<br />", "\n", str);
-        return str;
+/**
+ * Strip all tags and convert the entities back to their characters in a
+ * single pass.
+ *
+ * @param str The string to strip
+ * @param transform Additionally convert linebreak tags to newlines
+ *        beforehand and quote and fold the result like #MARKUP_STRIP
+ * @return a newly allocated string
+ */
+static char *markup_scan_strip(const char *str, bool transform)
+{
+        struct markup_writer w;
+        int open = 0;
+
+        markup_writer_init(&w, strlen(str), transform, transform && settings.ignore_newline);
+
+        for (const char *c = str; *c; c++) {
+                int br = transform ? markup_br_len(c) : 0;
+
+                if (br) {
+                        if (open == 0)
+                                markup_put_unquoted(&w, '\n');
+                        c += br - 1;
+                } else if (*c == '<') {
+                        open++;
+                } else if (*c == '>' && open > 0) {
+                        open--;
+                } else if (open == 0) {
+                        markup_put_unquoted(&w, *c);
+                }
+        }
+
+        return markup_writer_finish(&w);
 }
 
 /* see markup.h */
@@ -223,13 +337,10 @@ char *markup_strip(char *str)
 {
         ASSERT_OR_RET(str, NULL);
 
-        /* strip all tags */
-        string_strip_delimited(str, '<', '>');
-
-        /* unquote the remainder */
-        str = markup_unquote(str);
+        char *stripped = markup_scan_strip(str, false);
+        g_free(str);
 
-        return str;
+        return stripped;
 }
 
 /**
@@ -244,9 +355,6 @@ static bool markup_is_entity(const char *str)
         assert(str);
         assert(*str == '&');
 
-        char *end = strchr(str, ';');
-        ASSERT_OR_RET(end, false);
-
         // Parse (hexa)decimal entities with the format &#1234; or &#xABC;
         if (str[1] == '#') {
                 const char *cur = str + 2;
@@ -258,7 +366,7 @@ static bool markup_is_entity(const char *str)
                         if (*cur == ';')
                                 return false;
 
-                        while (isxdigit(*cur) && cur < end)
+                        while (isxdigit((unsigned char)*cur))
                                 cur++;
                 } else {
 
@@ -266,15 +374,14 @@ static bool markup_is_entity(const char *str)
                         if (*cur == ';')
                                 return false;
 
-                        while (isdigit(*cur) && cur < end)
+                        while (isdigit((unsigned char)*cur))
                                 cur++;
                 }
 
-                return (cur == end);
+                return *cur == ';';
         } else {
-                const char *supported_tags[] = {"&amp;", "&lt;", "&gt;", "&quot;", "&apos;"};
-                for (int i = 0; i < sizeof(supported_tags)/sizeof(*supported_tags); i++) {
-                        if (g_str_has_prefix(str, supported_tags[i]))
+                for (int i = 0; i < G_N_ELEMENTS(markup_entities); i++) {
+                        if (g_str_has_prefix(str, markup_entities[i].entity))
                                 return true;
                 }
                 return false;
@@ -282,27 +389,60 @@ static bool markup_is_entity(const char *str)
 }
 
 /**
- * Escape all unsupported and invalid &-entities in a string. If the resulting
- * string does not fit it will be reallocated.
+ * Quote all HTML special symbols in a single pass, like #MARKUP_NO
  *
- * @param str The string to be transformed
+ * @return a newly allocated string
  */
-static char *markup_escape_unsupported(char *str)
+static char *markup_scan_no(const char *str)
 {
-        ASSERT_OR_RET(str, NULL);
+        struct markup_writer w;
+
+        markup_writer_init(&w, strlen(str), true, settings.ignore_newline);
+        for (const char *c = str; *c; c++) {
+                /* Copy the runs without any special symbol at once */
+                gsize len = strcspn(c, "&\"'<>\n");
+                g_string_append_len(w.out, c, len);
+                c += len;
+                if (!*c)
+                        break;
+                markup_put(&w, *c);
+        }
+
+        return markup_writer_finish(&w);
+}
 
-        char *match = str;
-        while ((match = strchr(match, '&'))) {
-                if (!markup_is_entity(match)) {
-                        int pos = match - str;
-                        str = string_replace_at(str, pos, 1, "&amp;");
-                        match = str + pos + strlen("&amp;");
+/**
+ * Escape all unsupported and invalid &-entities and convert linebreak tags
+ * to newlines in a single pass, like #MARKUP_FULL. The a and img tags
+ * still have to get stripped afterwards.
+ *
+ * @return a newly allocated string
+ */
+static char *markup_scan_full(const char *str)
+{
+        struct markup_writer w;
+
+        markup_writer_init(&w, strlen(str), false, settings.ignore_newline);
+        for (const char *c = str; *c; c++) {
+                gsize len = strcspn(c, "&<\n");
+                g_string_append_len(w.out, c, len);
+                c += len;
+                if (!*c)
+                        break;
+
+                int br = markup_br_len(c);
+
+                if (br) {
+                        markup_put(&w, '\n');
+                        c += br - 1;
+                } else if (*c == '&' && !markup_is_entity(c)) {
+                        g_string_append_len(w.out, "&amp;", 5);
                 } else {
-                        match++;
+                        markup_put(&w, *c);
                 }
         }
 
-        return str;
+        return markup_writer_finish(&w);
 }
 
 /* see markup.h */
@@ -310,32 +450,28 @@ char *markup_transform(char *str, enum markup_mode markup_mode)
 {
         ASSERT_OR_RET(str, NULL);
 
+        char *transformed = NULL;
+
         switch (markup_mode) {
         case MARKUP_NULL:
                 /* `assert(false)`, but with a meaningful error message */
                 assert(markup_mode != MARKUP_NULL);
-                break;
+                return str;
         case MARKUP_NO:
-                str = markup_quote(str);
+                transformed = markup_scan_no(str);
                 break;
         case MARKUP_STRIP:
-                str = markup_br2nl(str);
-                str = markup_strip(str);
-                str = markup_quote(str);
+                transformed = markup_scan_strip(str, true);
                 break;
         case MARKUP_FULL:
-                str = markup_escape_unsupported(str);
-                str = markup_br2nl(str);
-                markup_strip_a(&str, NULL);
-                markup_strip_img(&str, NULL);
+                transformed = markup_scan_full(str);
+                markup_strip_a(&transformed, NULL);
+                markup_strip_img(&transformed, NULL);
                 break;
         }
 
-        if (settings.ignore_newline) {
-                str = string_replace_all("\n", " ", str);
-        }
-
-        return str;
+        g_free(str);
+        return transformed;
 }
 
 /* vim: set ft=c tabstop=8 shiftwidth=8 expandtab textwidth=0: */
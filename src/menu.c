@@ -4,13 +4,14 @@
 
 #include <errno.h>
 #include <glib.h>
-#include <regex.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/wait.h>
 #include <unistd.h>
+#include <wchar.h>
+#include <wctype.h>
 
 #include "dbus.h"
 #include "dunst.h"
@@ -20,78 +21,186 @@
 #include "settings.h"
 #include "utils.h"
 
-static bool is_initialized = false;
-static regex_t url_regex;
-
 static gpointer context_menu_thread(gpointer data);
 
 struct {
         GList *locked_notifications;
 } menu_ctx;
 
+/** The schemes, a URL has to start with (matched case insensitively) */
+static const char *url_prefixes[] = {
+        "http://", "https://", "ftp://", "ftps://", "news://", "mailto:", "file://", "www.",
+};
+
+/** The ASCII characters, which may appear inside a URL, besides letters and digits */
+#define URL_CHARS_INNER "-_@;/?:&=%$.+!*',~#"
+/** The ASCII characters, a URL may end with, besides letters, digits and ')' */
+#define URL_CHARS_FINAL "-_@;/?:&=%$+*~"
+
+/** The states of the scanner after the scheme of a URL */
+enum url_state {
+        URL_PATH,       //!< Any inner characters or parentheses may follow
+        URL_PARENS,     //!< Inside parentheses, only inner characters or ')' may follow
+        URL_TAIL,       //!< After parentheses, only final characters or parentheses may follow
+        URL_END,        //!< The URL can't get any longer
+};
+
+/** The classes of characters, which drive the transitions of the scanner */
+enum url_class {
+        URL_CLASS_OTHER,        //!< Terminates a URL
+        URL_CLASS_INNER,        //!< May appear inside, but not at the end of a URL
+        URL_CLASS_FINAL,        //!< May appear anywhere in a URL
+        URL_CLASS_OPEN,         //!< '('
+        URL_CLASS_CLOSE,        //!< ')'
+};
+
 /**
- * Initializes regexes needed for matching.
+ * Classify the character at str as part of a URL. Besides the ASCII
+ * characters, all letters and digits of the current locale are allowed,
+ * like [:alnum:] of the former regular expression. So in the C locale,
+ * non-ASCII bytes end a URL.
  *
- * @return true if initialization succeeded
+ * @param str the character to classify
+ * @param len (out) the length of the UTF-8 sequence at str
+ * @param alnum (out) (nullable) if it is a letter or digit
  */
-static bool regex_init(void)
+static enum url_class url_classify(const char *str, int *len, bool *alnum)
 {
-        if (is_initialized)
-                return true;
-
-        char *regex =
-            "\\<(https?://|ftps?://|news://|mailto:|file://|www\\.)"
-            "[-[:alnum:]_\\@;/?:&=%$.+!*\x27,~#]*"
-            "(\\([-[:alnum:]_\\@;/?:&=%$.+!*\x27,~#]*\\)|[-[:alnum:]_\\@;/?:&=%$+*~])+";
-        int code = regcomp(&url_regex, regex, REG_EXTENDED | REG_ICASE);
-        if (code != 0) {
-                char error_buf[120];
-                regerror(code, &url_regex, error_buf, sizeof(error_buf));
-                LOG_W("Failed to compile URL-matching regex: %s", error_buf);
-                return false;
+        unsigned char c = *str;
+        bool is_alnum;
+
+        *len = 1;
+        if (c < 0x80) {
+                is_alnum = g_ascii_isalnum(c);
         } else {
-                is_initialized = true;
-                return true;
+                mbstate_t state = { 0 };
+                wchar_t wc;
+                size_t n = mbrtowc(&wc, str, MB_CUR_MAX, &state);
+                is_alnum = n < (size_t) -2 && iswalnum(wc);
+                if (n < (size_t) -2)
+                        *len = n;
         }
+
+        if (alnum)
+                *alnum = is_alnum;
+
+        if (is_alnum || (c && strchr(URL_CHARS_FINAL, c)))
+                return URL_CLASS_FINAL;
+        if (c && strchr(URL_CHARS_INNER, c))
+                return URL_CLASS_INNER;
+        if (c == '(')
+                return URL_CLASS_OPEN;
+        if (c == ')')
+                return URL_CLASS_CLOSE;
+        return URL_CLASS_OTHER;
 }
 
-void regex_teardown(void)
+/**
+ * The transitions of the scanner
+ *
+ * The URL is the longest sequence matching the former regular expression
+ * `prefix [inner]* ( "(" [inner]* ")" | [final] )+`. So after the
+ * first parenthesis only final characters and further parentheses
+ * are allowed and the URL can only end after a final character or ')'.
+ */
+static const enum url_state url_transitions[][5] = {
+        /*               OTHER    INNER       FINAL       OPEN        CLOSE */
+        [URL_PATH]   = { URL_END, URL_PATH,   URL_PATH,   URL_PARENS, URL_END },
+        [URL_PARENS] = { URL_END, URL_PARENS, URL_PARENS, URL_END,    URL_TAIL },
+        [URL_TAIL]   = { URL_END, URL_END,    URL_TAIL,   URL_PARENS, URL_END },
+};
+
+/**
+ * Check if a scheme starts at str.
+ *
+ * @return the length of the scheme or 0, if there's no scheme at str
+ */
+static int url_prefix_len(const char *str)
 {
-        if (is_initialized) {
-                regfree(&url_regex);
-                is_initialized = false;
+        /* Reject most characters before comparing the schemes */
+        switch (g_ascii_tolower(*str)) {
+        case 'f': case 'h': case 'm': case 'n': case 'w':
+                break;
+        default:
+                return 0;
+        }
+
+        for (int i = 0; i < G_N_ELEMENTS(url_prefixes); i++) {
+                int len = strlen(url_prefixes[i]);
+                if (g_ascii_strncasecmp(str, url_prefixes[i], len) == 0)
+                        return len;
         }
+        return 0;
 }
 
-/* see menu.h */
-char *extract_urls(const char *to_match)
+/**
+ * Get the length of the URL after its scheme at str.
+ *
+ * @return the length of the longest valid URL or 0, if there is none
+ */
+static int url_scan(const char *str)
 {
-        if (!to_match)
-                return NULL;
+        enum url_state state = URL_PATH;
+        const char *c = str;
+        int match = 0;
 
-        if (!regex_init())
-                return NULL;
+        while (*c) {
+                int len;
+                enum url_class class = url_classify(c, &len, NULL);
 
-        char *urls = NULL;
-        const char *p = to_match;
-        regmatch_t m;
+                state = url_transitions[state][class];
+                if (state == URL_END)
+                        break;
+                c += len;
 
-        while (1) {
-                int nomatch = regexec(&url_regex, p, 1, &m, 0);
+                /* Without parentheses the URL may end after any final
+                 * character, with them only after the tail */
+                if (state == URL_TAIL || (state == URL_PATH && class == URL_CLASS_FINAL))
+                        match = c - str;
+        }
 
-                if (nomatch || m.rm_so == -1)
-                        break;
+        return match;
+}
 
-                int start = m.rm_so + (p - to_match);
-                int finish = m.rm_eo + (p - to_match);
+/* see menu.h */
+char *extract_urls(const char *to_match)
+{
+        if (!to_match)
+                return NULL;
 
-                char *match = g_strndup(to_match + start, finish - start);
-                urls = string_append(urls, match, "\n");
+        GString *urls = NULL;
+        const char *c = to_match;
+        /* URLs only start at the beginning of a word */
+        bool in_word = false;
+
+        while (*c) {
+                int prefix = in_word ? 0 : url_prefix_len(c);
+                int url = prefix ? url_scan(c + prefix) : 0;
+
+                if (url) {
+                        if (!urls)
+                                urls = g_string_new(NULL);
+                        else
+                                g_string_append_c(urls, '\n');
+                        g_string_append_len(urls, c, prefix + url);
+
+                        /* Continue searching like at the start of the string */
+                        c += prefix + url;
+                        in_word = false;
+                        continue;
+                }
 
-                g_free(match);
-                p += m.rm_eo;
+                if ((unsigned char) *c < 0x80) {
+                        in_word = g_ascii_isalnum(*c) || *c == '_';
+                        c++;
+                } else {
+                        int len;
+                        url_classify(c, &len, &in_word);
+                        c += len;
+                }
         }
-        return urls;
+
+        return urls ? g_string_free(urls, FALSE) : NULL;
 }
 
 /*
@@ -301,7 +410,7 @@ static GList *get_actionable_notifications(void)
              iter = iter->next) {
                 struct notification *n = iter->data;
 
-                if (n->urls || g_hash_table_size(n->actions)) {
+                if (notification_get_urls(n) || g_hash_table_size(n->actions)) {
                         notification_lock(n);
                         locked_notifications = g_list_prepend(locked_notifications, n);
                 }
@@ -372,6 +481,7 @@ static gpointer context_menu_thread(gpointer data)
                 dmenu_input = string_append(dmenu_input, dmenu_str, "\n");
                 g_free(dmenu_str);
 
+                /* The URLs got extracted before starting the thread */
                 if (n->urls)
                         dmenu_input = string_append(dmenu_input, n->urls, "\n");
         }
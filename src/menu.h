@@ -13,7 +13,6 @@ char *extract_urls(const char *to_match);
 
 void open_browser(const char *in);
 void invoke_action(const char *action);
-void regex_teardown(void);
 
 /**
  * Open the context menu that lets the user select urls/actions/etc.
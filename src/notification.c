@@ -5,6 +5,7 @@
 #include <assert.h>
 #include <errno.h>
 #include <glib.h>
+#include <inttypes.h>
 #include <libgen.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -43,11 +44,14 @@ const char *enum_to_string_fullscreen(enum behavior_fullscreen in)
 
 struct _notification_private {
         gint refcount;
+        bool urls_extracted;    //!< n->urls is valid, see notification_get_urls()
 };
 
 /* see notification.h */
-void notification_print(const struct notification *n)
+void notification_print(struct notification *n)
 {
+        const char *urls_list = notification_get_urls(n);
+
         //TODO: use logging info for this
         printf("{\n");
         printf("\tappname: '%s'\n", n->appname);
@@ -61,17 +65,17 @@ void notification_print(const struct notification *n)
         printf("\ttimeout: %ld\n", n->timeout/1000);
         printf("\turgency: %s\n", notification_urgency_to_string(n->urgency));
         printf("\ttransient: %d\n", n->transient);
-        printf("\tformatted: '%s'\n", n->msg);
-        printf("\tfg: %s\n", n->colors.fg);
-        printf("\tbg: %s\n", n->colors.bg);
-        printf("\thighlight: %s\n", n->colors.highlight);
-        printf("\tframe: %s\n", n->colors.frame);
+        printf("\tformatted: '%s'\n", notification_get_msg(n));
+        printf("\tfg: #%08"PRIx32"\n", n->colors.fg);
+        printf("\tbg: #%08"PRIx32"\n", n->colors.bg);
+        printf("\thighlight: #%08"PRIx32"\n", n->colors.highlight);
+        printf("\tframe: #%08"PRIx32"\n", n->colors.frame);
         printf("\tfullscreen: %s\n", enum_to_string_fullscreen(n->fullscreen));
         printf("\tprogress: %d\n", n->progress);
         printf("\tstack_tag: %s\n", (n->stack_tag ? n->stack_tag : ""));
         printf("\tid: %d\n", n->id);
-        if (n->urls) {
-                char *urls = string_replace_all("\n", "\t\t\n", g_strdup(n->urls));
+        if (urls_list) {
+                char *urls = string_replace_all("\n", "\t\t\n", g_strdup(urls_list));
                 printf("\turls:\n");
                 printf("\t{\n");
                 printf("\t\t%s\n", urls);
@@ -115,6 +119,8 @@ void notification_run_script(struct notification *n)
         const char *icon = n->iconname ? n->iconname : "";
 
         const char *urgency = notification_urgency_to_string(n->urgency);
+        /* Extract them before forking to keep them for later runs */
+        const char *urls = notification_get_urls(n);
 
         for(int i = 0; i < n->script_count; i++) {
 
@@ -149,7 +155,7 @@ void notification_run_script(struct notification *n)
                                 safe_setenv("DUNST_PROGRESS",  n_progress_str);
                                 safe_setenv("DUNST_CATEGORY",  n->category);
                                 safe_setenv("DUNST_STACK_TAG", n->stack_tag);
-                                safe_setenv("DUNST_URLS",      n->urls);
+                                safe_setenv("DUNST_URLS",      urls);
                                 safe_setenv("DUNST_TIMEOUT",   n_timeout_str);
                                 safe_setenv("DUNST_TIMESTAMP", n_timestamp_str);
                                 safe_setenv("DUNST_STACK_TAG", n->stack_tag);
@@ -210,6 +216,26 @@ int notification_cmp_data(const void *va, const void *vb, void *data)
         return notification_cmp(a, b);
 }
 
+/**
+ * Hash all fields of the notification, which get compared by
+ * notification_is_duplicate()
+ *
+ * @param n The notification to hash
+ * @returns The fingerprint of the notification
+ */
+static guint notification_fingerprint(const struct notification *n)
+{
+        guint hash = g_str_hash(n->appname);
+        hash = hash * 31 + g_str_hash(n->summary);
+        hash = hash * 31 + g_str_hash(n->body);
+        if (settings.icon_position != ICON_OFF && n->icon_id)
+                hash = hash * 31 + g_str_hash(n->icon_id);
+        hash = hash * 31 + n->urgency;
+
+        return hash;
+}
+
+/* see notification.h */
 bool notification_is_duplicate(const struct notification *a, const struct notification *b)
 {
         return STR_EQ(a->appname, b->appname)
@@ -280,17 +306,13 @@ void notification_unref(struct notification *n)
         g_free(n->category);
         g_free(n->text_to_render);
         g_free(n->urls);
-        g_free(n->colors.fg);
-        g_free(n->colors.bg);
-        g_free(n->colors.highlight);
-        g_free(n->colors.frame);
         g_free(n->stack_tag);
         g_free(n->desktop_entry);
 
         g_hash_table_unref(n->actions);
 
         if (n->icon)
-                g_object_unref(n->icon);
+                cairo_surface_destroy(n->icon);
         g_free(n->icon_id);
 
         notification_private_free(n->priv);
@@ -302,7 +324,52 @@ void notification_unref(struct notification *n)
         g_free(n);
 }
 
-void notification_icon_replace_path(struct notification *n, const char *new_icon)
+/**
+ * Set the icon of a notification, once it got decoded by the icon loader.
+ *
+ * @param pixbuf (nullable) The decoded icon
+ * @param id The id of the decoded icon
+ * @param data The notification waiting for the icon
+ */
+static void notification_icon_loaded(GdkPixbuf *pixbuf, const char *id, gpointer data)
+{
+        struct notification *n = data;
+
+        /* The icon got replaced in the meantime */
+        if (n->icon || !STR_EQ(n->icon_id, id))
+                return;
+
+        if (!pixbuf) {
+                g_clear_pointer(&n->icon_id, g_free);
+                return;
+        }
+
+        n->icon = icon_get_surface(pixbuf, id);
+        wake_up();
+}
+
+/**
+ * Load the icon of n->iconname. The icon may get decoded in the background.
+ */
+static void notification_icon_load(struct notification *n)
+{
+        g_clear_pointer(&n->icon, cairo_surface_destroy);
+        g_clear_pointer(&n->icon_id, g_free);
+
+        notification_ref(n);
+        GdkPixbuf *pixbuf = icon_get_for_name_async(n->iconname,
+                                                    &n->icon_id,
+                                                    notification_icon_loaded,
+                                                    n,
+                                                    (GDestroyNotify) notification_unref);
+        if (pixbuf) {
+                n->icon = icon_get_surface(pixbuf, n->icon_id);
+                g_object_unref(pixbuf);
+        }
+}
+
+/* see notification.h */
+void notification_icon_set_name(struct notification *n, const char *new_icon)
 {
         ASSERT_OR_RET(n,);
         ASSERT_OR_RET(new_icon,);
@@ -311,10 +378,18 @@ void notification_icon_replace_path(struct notification *n, const char *new_icon
         g_free(n->iconname);
         n->iconname = g_strdup(new_icon);
 
-        g_clear_object(&n->icon);
+        g_clear_pointer(&n->icon, cairo_surface_destroy);
         g_clear_pointer(&n->icon_id, g_free);
+}
 
-        n->icon = icon_get_for_name(new_icon, &n->icon_id);
+void notification_icon_replace_path(struct notification *n, const char *new_icon)
+{
+        ASSERT_OR_RET(n,);
+        ASSERT_OR_RET(new_icon,);
+        ASSERT_OR_RET(n->iconname != new_icon,);
+
+        notification_icon_set_name(n, new_icon);
+        notification_icon_load(n);
 }
 
 void notification_icon_replace_data(struct notification *n, GVariant *new_icon)
@@ -322,10 +397,14 @@ void notification_icon_replace_data(struct notification *n, GVariant *new_icon)
         ASSERT_OR_RET(n,);
         ASSERT_OR_RET(new_icon,);
 
-        g_clear_object(&n->icon);
+        g_clear_pointer(&n->icon, cairo_surface_destroy);
         g_clear_pointer(&n->icon_id, g_free);
 
-        n->icon = icon_get_for_data(new_icon, &n->icon_id);
+        GdkPixbuf *pixbuf = icon_get_for_data(new_icon, &n->icon_id);
+        if (pixbuf) {
+                n->icon = icon_get_surface(pixbuf, n->icon_id);
+                g_object_unref(pixbuf);
+        }
 }
 
 /* see notification.h */
@@ -391,6 +470,20 @@ struct notification *notification_create(void)
         return n;
 }
 
+/* see notification.h */
+void notification_colors_merge(struct notification_colors *dst, const struct notification_colors *src)
+{
+        if (src->set & COLOR_FRAME)
+                dst->frame = src->frame;
+        if (src->set & COLOR_BG)
+                dst->bg = src->bg;
+        if (src->set & COLOR_FG)
+                dst->fg = src->fg;
+        if (src->set & COLOR_HIGHLIGHT)
+                dst->highlight = src->highlight;
+        dst->set |= src->set;
+}
+
 /* see notification.h */
 void notification_init(struct notification *n)
 {
@@ -410,16 +503,12 @@ void notification_init(struct notification *n)
         if (n->timeout < 0)
                 n->timeout = settings.timeouts[n->urgency];
 
-        /* Icon handling */
+        /* Icon handling: only settle the name for the rules to match on,
+         * the icon gets loaded after the rules might have replaced it */
         if (STR_EMPTY(n->iconname))
                 g_clear_pointer(&n->iconname, g_free);
-        if (!n->icon && n->iconname) {
-                char *icon = g_strdup(n->iconname);
-                notification_icon_replace_path(n, icon);
-                g_free(icon);
-        }
         if (!n->icon && !n->iconname)
-                notification_icon_replace_path(n, settings.icons[n->urgency]);
+                n->iconname = g_strdup(settings.icons[n->urgency]);
 
         /* Color hints */
         struct notification_colors defcolors;
@@ -436,14 +525,9 @@ void notification_init(struct notification *n)
                 default:
                         g_error("Unhandled urgency type: %d", n->urgency);
         }
-        if (!n->colors.fg)
-                n->colors.fg = g_strdup(defcolors.fg);
-        if (!n->colors.bg)
-                n->colors.bg = g_strdup(defcolors.bg);
-        if (!n->colors.highlight)
-                n->colors.highlight = g_strdup(defcolors.highlight);
-        if (!n->colors.frame)
-                n->colors.frame = g_strdup(defcolors.frame);
+        defcolors.set = COLOR_ALL;
+        notification_colors_merge(&defcolors, &n->colors);
+        n->colors = defcolors;
 
         /* Sanitize misc hints */
         if (n->progress < 0)
@@ -452,111 +536,260 @@ void notification_init(struct notification *n)
         /* Process rules */
         rule_apply_all(n);
 
+        if (!n->icon && n->iconname)
+                notification_icon_load(n);
+
         if (g_str_has_prefix(n->summary, "DUNST_COMMAND_")) {
                 char *msg = "DUNST_COMMAND_* has been removed, please switch to dunstctl. See #830 for more details. https://github.com/dunst-project/dunst/pull/830";
                 LOG_W("%s", msg);
                 n->body = string_append(n->body, msg, "\n");
         }
 
-        /* UPDATE derived fields */
-        notification_extract_urls(n);
-        notification_format_message(n);
+        /* UPDATE derived fields, msg and urls get generated on first access */
+        n->fingerprint = notification_fingerprint(n);
+}
+
+/** The kinds of tokens in a compiled format string */
+enum format_token_kind {
+        FORMAT_TEXT,            //!< Literal text, which may contain markup
+        FORMAT_APPNAME,         //!< %a
+        FORMAT_SUMMARY,         //!< %s
+        FORMAT_BODY,            //!< %b
+        FORMAT_ICON_NAME,       //!< %I
+        FORMAT_ICON_PATH,       //!< %i
+        FORMAT_PROGRESS,        //!< %p
+        FORMAT_PROGRESS_VALUE,  //!< %n
+};
+
+struct format_token {
+        enum format_token_kind kind;
+        gsize offset;           //!< The start of a #FORMAT_TEXT in format::text
+        gsize len;              //!< The length of a #FORMAT_TEXT
+};
+
+//!< A format string split into literal text and the fields to substitute
+struct format {
+        GString *text;          //!< The literal parts of all #FORMAT_TEXT tokens
+        GArray *tokens;         //!< The tokens as struct format_token
+};
+
+/** The compiled formats by their format string: char* -> struct format* */
+static GHashTable *formats = NULL;
+
+static void format_free(gpointer data)
+{
+        struct format *fmt = data;
+
+        g_string_free(fmt->text, TRUE);
+        g_array_unref(fmt->tokens);
+        g_free(fmt);
+}
+
+/**
+ * Append literal text to the format, merging it into the previous token if
+ * that's literal text too.
+ */
+static void format_add_text(struct format *fmt, const char *text, gsize len)
+{
+        struct format_token *last = fmt->tokens->len
+                ? &g_array_index(fmt->tokens, struct format_token, fmt->tokens->len - 1)
+                : NULL;
+
+        if (last && last->kind == FORMAT_TEXT) {
+                last->len += len;
+        } else {
+                struct format_token token = { FORMAT_TEXT, fmt->text->len, len };
+                g_array_append_val(fmt->tokens, token);
+        }
+        g_string_append_len(fmt->text, text, len);
+}
+
+static void format_add_field(struct format *fmt, enum format_token_kind kind)
+{
+        struct format_token token = { kind, 0, 0 };
+        g_array_append_val(fmt->tokens, token);
+}
+
+/**
+ * Split the format string into tokens. Unknown or trailing % characters
+ * are kept as literal text.
+ */
+static struct format *format_compile(const char *format)
+{
+        struct format *fmt = g_malloc(sizeof(struct format));
+        char *src = string_replace_all("\\n", "\n", g_strdup(format));
+
+        fmt->text = g_string_new(NULL);
+        fmt->tokens = g_array_new(FALSE, FALSE, sizeof(struct format_token));
+
+        const char *c = src;
+        while (*c) {
+                if (*c != '%') {
+                        gsize len = strcspn(c, "%");
+                        format_add_text(fmt, c, len);
+                        c += len;
+                        continue;
+                }
+
+                switch (c[1]) {
+                case 'a': format_add_field(fmt, FORMAT_APPNAME); break;
+                case 's': format_add_field(fmt, FORMAT_SUMMARY); break;
+                case 'b': format_add_field(fmt, FORMAT_BODY); break;
+                case 'I': format_add_field(fmt, FORMAT_ICON_NAME); break;
+                case 'i': format_add_field(fmt, FORMAT_ICON_PATH); break;
+                case 'p': format_add_field(fmt, FORMAT_PROGRESS); break;
+                case 'n': format_add_field(fmt, FORMAT_PROGRESS_VALUE); break;
+                case '%': format_add_text(fmt, "%", 1); break;
+                case '\0':
+                        LOG_W("format_string has trailing %% character. "
+                              "To escape it use %%%%.");
+                        format_add_text(fmt, "%", 1);
+                        c++;
+                        continue;
+                default:
+                        LOG_W("format_string %%%c is unknown.", c[1]);
+                        // keep the % and interpret the next char as text
+                        format_add_text(fmt, "%", 1);
+                        c++;
+                        continue;
+                }
+                c += 2;
+        }
+
+        g_free(src);
+        return fmt;
+}
+
+/**
+ * Get the compiled form of a format string. Every distinct format string
+ * gets compiled only once.
+ */
+static const struct format *format_get(const char *format)
+{
+        if (!formats)
+                formats = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, format_free);
+
+        struct format *fmt = g_hash_table_lookup(formats, format);
+        if (!fmt) {
+                fmt = format_compile(format);
+                g_hash_table_insert(formats, g_strdup(format), fmt);
+        }
+        return fmt;
+}
+
+/**
+ * Append str to msg with all HTML special symbols converted to entities,
+ * like markup_transform() does with #MARKUP_NO.
+ */
+static void format_append_quoted(GString *msg, const char *str)
+{
+        const char *special = settings.ignore_newline ? "&\"'<>\n" : "&\"'<>";
+
+        while (*str) {
+                gsize len = strcspn(str, special);
+                g_string_append_len(msg, str, len);
+                str += len;
+
+                switch (*str) {
+                case '&':  g_string_append(msg, "&amp;"); break;
+                case '"':  g_string_append(msg, "&quot;"); break;
+                case '\'': g_string_append(msg, "&apos;"); break;
+                case '<':  g_string_append(msg, "&lt;"); break;
+                case '>':  g_string_append(msg, "&gt;"); break;
+                case '\n': g_string_append_c(msg, ' '); break;
+                default:   continue;
+                }
+                str++;
+        }
+}
+
+/**
+ * Append a field of the notification to msg, transformed according to the
+ * markup mode.
+ */
+static void format_append_field(GString *msg, const char *value, enum markup_mode markup_mode)
+{
+        if (!value)
+                return;
+
+        if (markup_mode == MARKUP_NO) {
+                format_append_quoted(msg, value);
+        } else {
+                char *transformed = markup_transform(g_strdup(value), markup_mode);
+                g_string_append(msg, transformed);
+                g_free(transformed);
+        }
+}
+
+/**
+ * Estimate the length of the formatted message to allocate it at once
+ */
+static gsize format_estimate_len(const struct format *fmt, const struct notification *n)
+{
+        gsize len = fmt->text->len + 1;
+
+        for (guint i = 0; i < fmt->tokens->len; i++) {
+                switch (g_array_index(fmt->tokens, struct format_token, i).kind) {
+                case FORMAT_APPNAME:    len += (n->appname ? strlen(n->appname) : 0); break;
+                case FORMAT_SUMMARY:    len += (n->summary ? strlen(n->summary) : 0); break;
+                case FORMAT_BODY:       len += (n->body ? strlen(n->body) : 0); break;
+                case FORMAT_ICON_NAME:
+                case FORMAT_ICON_PATH:  len += (n->iconname ? strlen(n->iconname) : 0); break;
+                default:                len += 8; break;
+                }
+        }
+        return len;
 }
 
 static void notification_format_message(struct notification *n)
 {
         g_clear_pointer(&n->msg, g_free);
 
-        n->msg = string_replace_all("\\n", "\n", g_strdup(n->format));
-
-        /* replace all formatter */
-        for(char *substr = strchr(n->msg, '%');
-                  substr && *substr;
-                  substr = strchr(substr, '%')) {
+        const struct format *fmt = format_get(n->format);
+        GString *msg = g_string_sized_new(format_estimate_len(fmt, n));
 
+        for (guint i = 0; i < fmt->tokens->len; i++) {
+                const struct format_token *token = &g_array_index(fmt->tokens, struct format_token, i);
                 char pg[16];
                 char *icon_tmp;
 
-                switch(substr[1]) {
-                case 'a':
-                        notification_replace_single_field(
-                                &n->msg,
-                                &substr,
-                                n->appname,
-                                MARKUP_NO);
+                switch (token->kind) {
+                case FORMAT_TEXT:
+                        g_string_append_len(msg, fmt->text->str + token->offset, token->len);
+                        break;
+                case FORMAT_APPNAME:
+                        format_append_field(msg, n->appname, MARKUP_NO);
                         break;
-                case 's':
-                        notification_replace_single_field(
-                                &n->msg,
-                                &substr,
-                                n->summary,
-                                MARKUP_NO);
+                case FORMAT_SUMMARY:
+                        format_append_field(msg, n->summary, MARKUP_NO);
                         break;
-                case 'b':
-                        notification_replace_single_field(
-                                &n->msg,
-                                &substr,
-                                n->body,
-                                n->markup);
+                case FORMAT_BODY:
+                        format_append_field(msg, n->body, n->markup);
                         break;
-                case 'I':
+                case FORMAT_ICON_NAME:
                         icon_tmp = g_strdup(n->iconname);
-                        notification_replace_single_field(
-                                &n->msg,
-                                &substr,
-                                icon_tmp ? basename(icon_tmp) : "",
-                                MARKUP_NO);
+                        format_append_field(msg, icon_tmp ? basename(icon_tmp) : "", MARKUP_NO);
                         g_free(icon_tmp);
                         break;
-                case 'i':
-                        notification_replace_single_field(
-                                &n->msg,
-                                &substr,
-                                n->iconname ? n->iconname : "",
-                                MARKUP_NO);
+                case FORMAT_ICON_PATH:
+                        format_append_field(msg, n->iconname ? n->iconname : "", MARKUP_NO);
                         break;
-                case 'p':
-                        if (n->progress != -1)
+                case FORMAT_PROGRESS:
+                        if (n->progress != -1) {
                                 sprintf(pg, "[%3d%%]", n->progress);
-
-                        notification_replace_single_field(
-                                &n->msg,
-                                &substr,
-                                n->progress != -1 ? pg : "",
-                                MARKUP_NO);
+                                g_string_append(msg, pg);
+                        }
                         break;
-                case 'n':
-                        if (n->progress != -1)
+                case FORMAT_PROGRESS_VALUE:
+                        if (n->progress != -1) {
                                 sprintf(pg, "%d", n->progress);
-
-                        notification_replace_single_field(
-                                &n->msg,
-                                &substr,
-                                n->progress != -1 ? pg : "",
-                                MARKUP_NO);
-                        break;
-                case '%':
-                        notification_replace_single_field(
-                                &n->msg,
-                                &substr,
-                                "%",
-                                MARKUP_NO);
-                        break;
-                case '\0':
-                        LOG_W("format_string has trailing %% character. "
-                              "To escape it use %%%%.");
-                        substr++;
-                        break;
-                default:
-                        LOG_W("format_string %%%c is unknown.", substr[1]);
-                        // shift substr pointer forward,
-                        // as we can't interpret the format string
-                        substr++;
+                                g_string_append(msg, pg);
+                        }
                         break;
                 }
         }
 
-        n->msg = g_strchomp(n->msg);
+        n->msg = g_strchomp(g_string_free(msg, FALSE));
 
         /* truncate overlong messages */
         if (strnlen(n->msg, DUNST_NOTIF_MAX_CHARS + 1) > DUNST_NOTIF_MAX_CHARS) {
@@ -566,6 +799,94 @@ static void notification_format_message(struct notification *n)
         }
 }
 
+/* see notification.h */
+void notification_formats_teardown(void)
+{
+        g_clear_pointer(&formats, g_hash_table_unref);
+}
+
+/**
+ * Check if the string contains anything, that g_strchomp() wouldn't strip
+ */
+static bool str_has_text(const char *str)
+{
+        for (; str && *str; str++)
+                if (!g_ascii_isspace(*str))
+                        return true;
+        return false;
+}
+
+/**
+ * Check if formatting the notification surely gives a message with text
+ * without formatting it. If there's any doubt, the message has to get
+ * formatted.
+ */
+static bool format_has_text(const struct format *fmt, const struct notification *n)
+{
+        for (guint i = 0; i < fmt->tokens->len; i++) {
+                const struct format_token *token = &g_array_index(fmt->tokens, struct format_token, i);
+
+                switch (token->kind) {
+                case FORMAT_TEXT:
+                        for (gsize c = token->offset; c < token->offset + token->len; c++)
+                                if (!g_ascii_isspace(fmt->text->str[c]))
+                                        return true;
+                        break;
+                case FORMAT_APPNAME:
+                        if (str_has_text(n->appname))
+                                return true;
+                        break;
+                case FORMAT_SUMMARY:
+                        if (str_has_text(n->summary))
+                                return true;
+                        break;
+                case FORMAT_BODY:
+                        /* Without any tag, no markup mode strips characters */
+                        if (str_has_text(n->body) && (n->markup == MARKUP_NO || !strchr(n->body, '<')))
+                                return true;
+                        break;
+                case FORMAT_ICON_PATH:
+                        if (str_has_text(n->iconname))
+                                return true;
+                        break;
+                case FORMAT_PROGRESS:
+                case FORMAT_PROGRESS_VALUE:
+                        if (n->progress != -1)
+                                return true;
+                        break;
+                default:
+                        break;
+                }
+        }
+        return false;
+}
+
+/* see notification.h */
+const char *notification_get_msg(struct notification *n)
+{
+        if (!n->msg)
+                notification_format_message(n);
+        return n->msg;
+}
+
+/* see notification.h */
+bool notification_msg_is_empty(struct notification *n)
+{
+        if (!n->msg && format_has_text(format_get(n->format), n))
+                return false;
+        return STR_EMPTY(notification_get_msg(n));
+}
+
+/* see notification.h */
+const char *notification_get_urls(struct notification *n)
+{
+        if (!n->priv->urls_extracted) {
+                notification_extract_urls(n);
+                n->priv->urls_extracted = true;
+        }
+        return n->urls;
+}
+
 static void notification_extract_urls(struct notification *n)
 {
         g_clear_pointer(&n->urls, g_free);
@@ -597,19 +918,20 @@ void notification_update_text_to_render(struct notification *n)
 
         char *buf = NULL;
 
-        char *msg = g_strchomp(n->msg);
+        const char *msg = notification_get_msg(n);
+        const char *urls = notification_get_urls(n);
 
         /* print dup_count and msg */
         if ((n->dup_count > 0 && !settings.hide_duplicate_count)
-            && (g_hash_table_size(n->actions) || n->urls) && settings.show_indicators) {
+            && (g_hash_table_size(n->actions) || urls) && settings.show_indicators) {
                 buf = g_strdup_printf("(%d%s%s) %s",
                                       n->dup_count,
                                       g_hash_table_size(n->actions) ? "A" : "",
-                                      n->urls ? "U" : "", msg);
-        } else if ((g_hash_table_size(n->actions) || n->urls) && settings.show_indicators) {
+                                      urls ? "U" : "", msg);
+        } else if ((g_hash_table_size(n->actions) || urls) && settings.show_indicators) {
                 buf = g_strdup_printf("(%s%s) %s",
                                       g_hash_table_size(n->actions) ? "A" : "",
-                                      n->urls ? "U" : "", msg);
+                                      urls ? "U" : "", msg);
         } else if (n->dup_count > 0 && !settings.hide_duplicate_count) {
                 buf = g_strdup_printf("(%d) %s", n->dup_count, msg);
         } else {
@@ -647,8 +969,10 @@ void notification_update_text_to_render(struct notification *n)
 }
 
 /* see notification.h */
-void notification_do_action(const struct notification *n)
+void notification_do_action(struct notification *n)
 {
+        const char *urls = notification_get_urls(n);
+
         if (g_hash_table_size(n->actions)) {
                 if (g_hash_table_contains(n->actions, "default")) {
                         signal_action_invoked(n, "default");
@@ -662,11 +986,11 @@ void notification_do_action(const struct notification *n)
                 }
                 context_menu();
 
-        } else if (n->urls) {
-                if (strstr(n->urls, "\n"))
+        } else if (urls) {
+                if (strstr(urls, "\n"))
                         context_menu();
                 else
-                        open_browser(n->urls);
+                        open_browser(urls);
         }
 }
 
@@ -2,9 +2,10 @@
 #ifndef DUNST_NOTIFICATION_H
 #define DUNST_NOTIFICATION_H
 
-#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <cairo.h>
 #include <glib.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "markup.h"
 
@@ -29,11 +30,22 @@ enum urgency {
 
 typedef struct _notification_private NotificationPrivate;
 
+//!< The fields of struct notification_colors as flags
+enum color_field {
+        COLOR_FRAME     = 1 << 0,
+        COLOR_BG        = 1 << 1,
+        COLOR_FG        = 1 << 2,
+        COLOR_HIGHLIGHT = 1 << 3,
+        COLOR_ALL       = COLOR_FRAME | COLOR_BG | COLOR_FG | COLOR_HIGHLIGHT,
+};
+
+//!< The colors of a notification, each packed as 0xRRGGBBAA
 struct notification_colors {
-        char *frame;
-        char *bg;
-        char *fg;
-        char *highlight;
+        uint32_t frame;
+        uint32_t bg;
+        uint32_t fg;
+        uint32_t highlight;
+        unsigned int set;       //!< The #color_field flags of the colors, which got set
 };
 
 struct notification {
@@ -49,8 +61,8 @@ struct notification {
         char *desktop_entry;     /**< The desktop entry hint sent via every GApplication */
         enum urgency urgency;
 
-        GdkPixbuf *icon;         /**< The raw cached icon data used to draw */
-        char *icon_id;           /**< plain icon information, which acts as the pixbuf's id, which is saved in .icon
+        cairo_surface_t *icon;   /**< The icon converted for drawing, shared between notifications with the same icon_id */
+        char *icon_id;           /**< plain icon information, which acts as the icon's id, which is saved in .icon
                                       May be a hash for a raw icon or a name/path for a regular app icon. */
         char *iconname;          /**< plain icon information (may be a path or just a name)
                                       Use this to compare the icon name with rules.*/
@@ -84,11 +96,12 @@ struct notification {
         enum behavior_fullscreen fullscreen; //!< The instruction what to do with it, when desktop enters fullscreen
         bool script_run;        /**< Has the script been executed already? */
         guint8 marked_for_closure;
+        guint fingerprint;      /**< hash of all fields compared by notification_is_duplicate() */
 
         /* derived fields */
-        char *msg;            /**< formatted message */
+        char *msg;            /**< formatted message, use notification_get_msg() */
         char *text_to_render; /**< formatted message (with age and action indicators) */
-        char *urls;           /**< urllist delimited by '\\n' */
+        char *urls;           /**< urllist delimited by '\\n', use notification_get_urls() */
 };
 
 /**
@@ -113,6 +126,11 @@ gint notification_refcount_get(struct notification *n);
  */
 void notification_ref(struct notification *n);
 
+/**
+ * Overwrite the colors in dst with all colors set in src.
+ */
+void notification_colors_merge(struct notification_colors *dst, const struct notification_colors *src);
+
 /**
  * Sanitize values of notification, apply all matching rules
  * and generate derived fields.
@@ -139,6 +157,11 @@ int notification_cmp(const struct notification *a, const struct notification *b)
  */
 int notification_cmp_data(const void *va, const void *vb, void *data);
 
+/**
+ * Check if both notifications are duplicates of each other.
+ *
+ * Duplicates always have the same #notification.fingerprint.
+ */
 bool notification_is_duplicate(const struct notification *a, const struct notification *b);
 
 bool notification_is_locked(struct notification *n);
@@ -152,11 +175,24 @@ struct notification *notification_unlock(struct notification *n);
  * Removes the reference for the previous icon automatically and will also free the
  * iconname field. So passing n->iconname as new_icon is invalid.
  *
+ * If the icon isn't cached, it may get decoded in the background. Then
+ * n->icon stays NULL until it is done and a redraw gets scheduled.
+ *
  * @param n the notification to replace the icon
  * @param new_icon The path of the new icon. May be an absolute path or an icon name.
  */
 void notification_icon_replace_path(struct notification *n, const char *new_icon);
 
+/**Replace the current notification's icon name without loading the icon.
+ *
+ * Drops the current icon. notification_init() loads the icon of the final
+ * name once, after all rules got applied.
+ *
+ * @param n the notification to replace the icon name
+ * @param new_icon The path of the new icon. May be an absolute path or an icon name.
+ */
+void notification_icon_set_name(struct notification *n, const char *new_icon);
+
 /**Replace the current notification's icon with the raw icon given in the GVariant.
  *
  * Removes the reference for the previous icon automatically.
@@ -178,7 +214,7 @@ void notification_run_script(struct notification *n);
  * print a human readable representation
  * of the given notification to stdout.
  */
-void notification_print(const struct notification *n);
+void notification_print(struct notification *n);
 
 /**
  * Replace the two chars where **needle points
@@ -194,12 +230,39 @@ void notification_replace_single_field(char **haystack,
 
 void notification_update_text_to_render(struct notification *n);
 
+/**
+ * Get the message formatted according to n->format. It gets formatted on
+ * the first call.
+ */
+const char *notification_get_msg(struct notification *n);
+
+/**
+ * Check if the formatted message is empty. Formats the message only if
+ * this can't be decided from the format and the fields of the
+ * notification.
+ */
+bool notification_msg_is_empty(struct notification *n);
+
+/**
+ * Get the URLs in the summary and body delimited by '\n'. They get
+ * extracted on the first call.
+ *
+ * @retval NULL: The notification doesn't contain any URL
+ */
+const char *notification_get_urls(struct notification *n);
+
+/**
+ * Free the compiled format strings. They get compiled again on their next
+ * use.
+ */
+void notification_formats_teardown(void);
+
 /**
  * If the notification has exactly one action, or one is marked as default,
  * invoke it. If there are multiple and no default, open the context menu. If
  * there are no actions, proceed similarly with urls.
  */
-void notification_do_action(const struct notification *n);
+void notification_do_action(struct notification *n);
 
 /**
  * Remove all client action data from the notification.
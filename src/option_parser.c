@@ -172,9 +172,8 @@ bool string_parse_sepcolor(const char *s, struct separator_color_data *ret)
         STRING_PARSE_RET("frame",      (struct separator_color_data){.type = SEP_FRAME});
 
         ret->type = SEP_CUSTOM;
-        ret->sep_color = g_strdup(s);
 
-        return true;
+        return string_parse_color(s, &ret->sep_color);
 }
 
 bool string_parse_urgency(const char *s, enum urgency *ret)
@@ -189,6 +188,49 @@ bool string_parse_urgency(const char *s, enum urgency *ret)
         return false;
 }
 
+/**
+ * Parse a color of the form #RGB, #RGBA, #RRGGBB or #RRGGBBAA.
+ *
+ * @param s The color string
+ * @param ret The color packed as 0xRRGGBBAA
+ */
+bool string_parse_color(const char *s, uint32_t *ret)
+{
+        ASSERT_OR_RET(STR_FULL(s), false);
+        ASSERT_OR_RET(ret, false);
+
+        if (s[0] != '#')
+                return false;
+
+        uint32_t val = 0;
+        int len = 0;
+        for (const char *c = s + 1; *c; c++, len++) {
+                if (!g_ascii_isxdigit(*c) || len >= 8)
+                        return false;
+                val = (val << 4) | g_ascii_xdigit_value(*c);
+        }
+
+        switch (len) {
+        case 3:
+                val = (val << 4) | 0xF;
+                /* fall through */
+        case 4:
+                /* Widen each digit to a byte */
+                val = ((val & 0xF000) << 12) | ((val & 0x0F00) << 8)
+                    | ((val & 0x00F0) << 4)  |  (val & 0x000F);
+                *ret = val * 0x11;
+                return true;
+        case 6:
+                *ret = (val << 8) | 0xFF;
+                return true;
+        case 8:
+                *ret = val;
+                return true;
+        default:
+                return false;
+        }
+}
+
 bool string_parse_layer(const char *s, enum zwlr_layer_shell_v1_layer *ret)
 {
         ASSERT_OR_RET(STR_FULL(s), false);
@@ -698,6 +740,25 @@ int option_get_bool(const char *ini_section,
         return ini_get_bool(ini_section, ini_key, def);
 }
 
+uint32_t option_get_color(const char *ini_section,
+                          const char *ini_key,
+                          const char *cmdline_key,
+                          uint32_t def,
+                          const char *description)
+{
+        uint32_t val;
+        char *c = option_get_string(ini_section, ini_key, cmdline_key, NULL, description);
+
+        if (!string_parse_color(c, &val)) {
+                if (c)
+                        LOG_W("Invalid color value: '%s'", c);
+                val = def;
+        }
+
+        g_free(c);
+        return val;
+}
+
 void cmdline_usage_append(const char *key, const char *type, const char *description)
 {
         char *key_type;
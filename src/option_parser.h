@@ -4,6 +4,7 @@
 
 #include <glib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
 #include "dunst.h"
@@ -20,6 +21,7 @@ bool string_parse_mouse_action(const char *s, enum mouse_action *ret);
 bool string_parse_mouse_action_list(char **s, enum mouse_action **ret);
 bool string_parse_sepcolor(const char *s, struct separator_color_data *ret);
 bool string_parse_urgency(const char *s, enum urgency *ret);
+bool string_parse_color(const char *s, uint32_t *ret);
 bool string_parse_layer(const char *s, enum zwlr_layer_shell_v1_layer *ret);
 
 int load_ini_file(FILE *);
@@ -79,6 +81,11 @@ int option_get_bool(const char *ini_section,
                     const char *cmdline_key,
                     int def,
                     const char *description);
+uint32_t option_get_color(const char *ini_section,
+                          const char *ini_key,
+                          const char *cmdline_key,
+                          uint32_t def,
+                          const char *description);
 
 /* returns the next known section.
  * if section == NULL returns first section.
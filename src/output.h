@@ -36,7 +36,16 @@ struct output {
         void (*win_show)(window);
         void (*win_hide)(window);
 
-        void (*display_surface)(cairo_surface_t *srf, window win, const struct dimensions*);
+        /**
+         * Show the image of all notifications in the window
+         *
+         * @param srf The image of all notifications
+         * @param win The window to show the image in
+         * @param dim The dimensions and position of the window
+         * @param damage (nullable) The areas of srf, which changed since
+         *               the last call, NULL if everything changed
+         */
+        void (*display_surface)(cairo_surface_t *srf, window win, const struct dimensions *dim, const cairo_region_t *damage);
 
         cairo_t* (*win_get_context)(window);
 
@@ -32,6 +32,40 @@ static GQueue *waiting   = NULL; /**< all new notifications get into here */
 static GQueue *displayed = NULL; /**< currently displayed notifications */
 static GQueue *history   = NULL; /**< history of displayed notifications */
 
+/**
+ * The position of a notification inside the queues
+ */
+struct queue_entry {
+        GQueue *queue;         /**< The queue, which contains the notification */
+        GList *link;           /**< The link of the notification inside #queue */
+        GSequenceIter *expiry; /**< The position inside #expiry or #paused, if the notification is displayed and times out */
+        GList *history;        /**< The first notification with the id in #history, NULL if there is none */
+        guint history_count;   /**< The amount of notifications with the id in #history */
+};
+
+/** Index of all queued notifications: notification id -> struct queue_entry */
+static GHashTable *id_index = NULL;
+
+/** Displayed and waiting notifications by g_str_hash() of their stack tag -> GQueue of links */
+static GHashTable *tag_index = NULL;
+
+/** Displayed and waiting notifications by their duplicate fingerprint -> GQueue of links */
+static GHashTable *dup_index = NULL;
+
+/** Displayed notifications, which time out, ordered by the time they do so */
+static GSequence *expiry = NULL;
+/** Displayed notifications, which don't time out while the user is idle, ordered by their timeout */
+static GSequence *paused = NULL;
+/** If the notifications in #paused are held back, because the user is idle */
+static bool expiry_paused = false;
+
+/** First link of every urgency in waiting (only maintained if settings.sort is set) */
+static GList *waiting_first[URG_MAX + 1] = { NULL };
+/** Last link of every urgency in waiting (only maintained if settings.sort is set) */
+static GList *waiting_last[URG_MAX + 1] = { NULL };
+/** Amount of waiting notifications, which are allowed to get shown in fullscreen */
+static unsigned int waiting_fs_show = 0;
+
 int next_notification_id = 1;
 
 static bool queues_stack_duplicate(struct notification *n);
@@ -43,6 +77,19 @@ void queues_init(void)
         history   = g_queue_new();
         displayed = g_queue_new();
         waiting   = g_queue_new();
+
+        id_index = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+        tag_index = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) g_queue_free);
+        dup_index = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) g_queue_free);
+        expiry = g_sequence_new(NULL);
+        paused = g_sequence_new(NULL);
+        expiry_paused = false;
+
+        for (int urg = URG_MIN; urg <= URG_MAX; urg++) {
+                waiting_first[urg] = NULL;
+                waiting_last[urg] = NULL;
+        }
+        waiting_fs_show = 0;
 }
 
 /* see queues.h */
@@ -77,6 +124,417 @@ unsigned int queues_length_history(void)
         return history->length;
 }
 
+/**
+ * Add a link to the bucket of `key` in one of the stacking indices.
+ *
+ * @param index The index to add the link to
+ * @param key   The hash value of the notification's stacking property
+ * @param link  The link of the notification
+ */
+static void queues_bucket_add(GHashTable *index, guint key, GList *link)
+{
+        GQueue *bucket = g_hash_table_lookup(index, GUINT_TO_POINTER(key));
+
+        if (!bucket) {
+                bucket = g_queue_new();
+                g_hash_table_insert(index, GUINT_TO_POINTER(key), bucket);
+        }
+
+        g_queue_push_tail(bucket, link);
+}
+
+/**
+ * Remove a link from the bucket of `key` in one of the stacking indices.
+ *
+ * @param index The index to remove the link from
+ * @param key   The hash value of the notification's stacking property
+ * @param link  The link of the notification
+ */
+static void queues_bucket_remove(GHashTable *index, guint key, GList *link)
+{
+        GQueue *bucket = g_hash_table_lookup(index, GUINT_TO_POINTER(key));
+
+        if (!bucket)
+                return;
+
+        g_queue_remove(bucket, link);
+        if (g_queue_is_empty(bucket))
+                g_hash_table_remove(index, GUINT_TO_POINTER(key));
+}
+
+/**
+ * Update the urgency bounds of waiting after a link got inserted
+ * at its sorted position.
+ *
+ * @param link The inserted link
+ */
+static void queues_waiting_bounds_add(GList *link)
+{
+        enum urgency urg = ((struct notification*)link->data)->urgency;
+
+        if (!waiting_first[urg] || link->next == waiting_first[urg])
+                waiting_first[urg] = link;
+        if (!waiting_last[urg] || link->prev == waiting_last[urg])
+                waiting_last[urg] = link;
+}
+
+/**
+ * Update the urgency bounds of waiting before a link gets removed.
+ *
+ * @param link The link, which is about to get removed
+ */
+static void queues_waiting_bounds_remove(GList *link)
+{
+        enum urgency urg = ((struct notification*)link->data)->urgency;
+
+        if (waiting_first[urg] == link)
+                waiting_first[urg] = waiting_last[urg] == link ? NULL : link->next;
+        if (waiting_last[urg] == link)
+                waiting_last[urg] = waiting_first[urg] ? link->prev : NULL;
+}
+
+/**
+ * Check if a notification times out when it's displayed
+ *
+ * @param n The notification to check
+ */
+static bool queues_notification_expires(const struct notification *n)
+{
+        return n->timeout != 0 || (n->skip_display && !n->redisplayed);
+}
+
+/**
+ * Get the point in time, after which a displayed notification is timed out
+ *
+ * @param n The notification to check
+ * @returns The monotonic time in microseconds
+ */
+static gint64 queues_notification_deadline(const struct notification *n)
+{
+        if (n->skip_display && !n->redisplayed)
+                return G_MININT64;
+
+        return n->start + n->timeout;
+}
+
+/**
+ * Order notifications by their deadline to match GCompareDataFunc
+ */
+static gint queues_expiry_cmp(gconstpointer a, gconstpointer b, gpointer data)
+{
+        gint64 deadline_a = queues_notification_deadline(a);
+        gint64 deadline_b = queues_notification_deadline(b);
+
+        return (deadline_a > deadline_b) - (deadline_a < deadline_b);
+}
+
+/**
+ * Check if a displayed notification stops timing out while the user is idle
+ *
+ * @param n The notification to check
+ */
+static bool queues_notification_pauses(const struct notification *n)
+{
+        return !n->transient && !(n->skip_display && !n->redisplayed);
+}
+
+/**
+ * Order notifications by their timeout to match GCompareDataFunc
+ */
+static gint queues_timeout_cmp(gconstpointer a, gconstpointer b, gpointer data)
+{
+        gint64 timeout_a = ((const struct notification *) a)->timeout;
+        gint64 timeout_b = ((const struct notification *) b)->timeout;
+
+        return (timeout_a > timeout_b) - (timeout_a < timeout_b);
+}
+
+/**
+ * Register the notification of the given link in the id index.
+ *
+ * Notifications in displayed and waiting take precedence over the
+ * notifications with the same id in history. Of those, the first one
+ * in history gets found.
+ *
+ * @param queue The queue, which contains `link`
+ * @param link  The link of the notification to register
+ */
+static void queues_index_set(GQueue *queue, GList *link)
+{
+        struct notification *n = link->data;
+        struct queue_entry *entry = g_hash_table_lookup(id_index, GINT_TO_POINTER(n->id));
+
+        if (!entry) {
+                entry = g_malloc0(sizeof(struct queue_entry));
+                g_hash_table_insert(id_index, GINT_TO_POINTER(n->id), entry);
+        }
+
+        if (queue == history) {
+                if (!entry->history)
+                        entry->history = link;
+                entry->history_count++;
+
+                if (entry->queue && entry->queue != history)
+                        return;
+                link = entry->history;
+        }
+
+        entry->queue = queue;
+        entry->link = link;
+        entry->expiry = NULL;
+
+        if (queue == history)
+                return;
+
+        if (queue == displayed && queues_notification_expires(n)) {
+                if (expiry_paused && queues_notification_pauses(n))
+                        entry->expiry = g_sequence_insert_sorted(paused, n, queues_timeout_cmp, NULL);
+                else
+                        entry->expiry = g_sequence_insert_sorted(expiry, n, queues_expiry_cmp, NULL);
+        }
+
+        if (queue == waiting) {
+                if (settings.sort)
+                        queues_waiting_bounds_add(link);
+                if (n->fullscreen == FS_SHOW)
+                        waiting_fs_show++;
+        }
+
+        if (STR_FULL(n->stack_tag))
+                queues_bucket_add(tag_index, g_str_hash(n->stack_tag), link);
+        queues_bucket_add(dup_index, n->fingerprint, link);
+}
+
+/**
+ * Find the first notification with the given id in history.
+ *
+ * @param id   The id of the notification
+ * @param skip The link to ignore
+ * @returns The link of the notification
+ * @retval NULL: No other notification with this id is in history
+ */
+static GList *queues_history_find(int id, GList *skip)
+{
+        for (GList *iter = g_queue_peek_head_link(history); iter; iter = iter->next) {
+                if (iter != skip && ((struct notification*)iter->data)->id == id)
+                        return iter;
+        }
+
+        return NULL;
+}
+
+/**
+ * Remove the notification of the given link from the id index.
+ *
+ * If the notification leaves displayed or waiting, the id keeps pointing
+ * to the notification with the same id in history, if there is one.
+ *
+ * @param queue The queue, which contains `link`
+ * @param link  The link of the notification to unregister
+ */
+static void queues_index_remove(GQueue *queue, GList *link)
+{
+        struct notification *n = link->data;
+        struct queue_entry *entry = g_hash_table_lookup(id_index, GINT_TO_POINTER(n->id));
+
+        if (!entry)
+                return;
+
+        if (queue == history) {
+                entry->history_count--;
+                if (entry->history == link)
+                        entry->history = entry->history_count ? queues_history_find(n->id, link) : NULL;
+
+                if (entry->queue != history)
+                        return;
+                if (entry->history) {
+                        entry->link = entry->history;
+                        return;
+                }
+                g_hash_table_remove(id_index, GINT_TO_POINTER(n->id));
+                return;
+        }
+
+        if (entry->link != link)
+                return;
+
+        if (entry->expiry)
+                g_sequence_remove(entry->expiry);
+
+        if (entry->queue == waiting) {
+                if (settings.sort)
+                        queues_waiting_bounds_remove(link);
+                if (n->fullscreen == FS_SHOW)
+                        waiting_fs_show--;
+        }
+
+        if (STR_FULL(n->stack_tag))
+                queues_bucket_remove(tag_index, g_str_hash(n->stack_tag), link);
+        queues_bucket_remove(dup_index, n->fingerprint, link);
+
+        if (entry->history) {
+                entry->queue = history;
+                entry->link = entry->history;
+                entry->expiry = NULL;
+                return;
+        }
+
+        g_hash_table_remove(id_index, GINT_TO_POINTER(n->id));
+}
+
+/**
+ * Look up the position of the notification with the given id
+ *
+ * @param id The id of the notification
+ * @returns The position of the notification
+ * @retval NULL: No notification with this id is in any queue
+ */
+static struct queue_entry *queues_index_lookup(int id)
+{
+        return g_hash_table_lookup(id_index, GINT_TO_POINTER(id));
+}
+
+/**
+ * Find a displayed or waiting notification, which `n` may get stacked onto.
+ *
+ * Displayed notifications are preferred over waiting ones.
+ *
+ * @param index The stacking index to search in
+ * @param key   The hash value of the stacking property of `n`
+ * @param n     The new notification
+ * @param match Function to verify, that a candidate shares the stacking property with `n`
+ * @param queue (nullable) Return location for the queue of the found notification
+ * @returns The link of the found notification
+ * @retval NULL: No notification matched
+ */
+static GList *queues_bucket_find(GHashTable *index,
+                                 guint key,
+                                 const struct notification *n,
+                                 bool (*match)(const struct notification *a, const struct notification *b),
+                                 GQueue **queue)
+{
+        GQueue *bucket = g_hash_table_lookup(index, GUINT_TO_POINTER(key));
+        struct queue_entry *found = NULL;
+
+        if (!bucket)
+                return NULL;
+
+        for (GList *iter = g_queue_peek_head_link(bucket); iter; iter = iter->next) {
+                GList *link = iter->data;
+                if (!match(link->data, n))
+                        continue;
+
+                struct queue_entry *entry = queues_index_lookup(((struct notification*)link->data)->id);
+                if (!found || entry->queue == displayed)
+                        found = entry;
+                if (found->queue == displayed)
+                        break;
+        }
+
+        if (!found)
+                return NULL;
+
+        if (queue)
+                *queue = found->queue;
+        return found->link;
+}
+
+/**
+ * Check if both notifications share the same non-empty stack tag
+ */
+static bool queues_stack_tag_equal(const struct notification *a, const struct notification *b)
+{
+        return STR_FULL(a->stack_tag) && STR_EQ(a->stack_tag, b->stack_tag);
+}
+
+/**
+ * Find the link in waiting, before which `n` has to get inserted.
+ *
+ * Instead of walking waiting from its head, start at the end of the
+ * urgency of `n` and walk backwards. New notifications carry the
+ * highest id, so this usually finishes after a single comparison.
+ *
+ * @pre settings.sort is set
+ *
+ * @param n The notification to insert
+ * @returns The sibling for g_queue_insert_before()
+ */
+static GList *queues_waiting_find_sibling(const struct notification *n)
+{
+        GList *prev = NULL;
+        for (int urg = n->urgency; urg <= URG_MAX && !prev; urg++)
+                prev = waiting_last[urg];
+
+        while (prev && notification_cmp(prev->data, n) >= 0)
+                prev = prev->prev;
+
+        return prev ? prev->next : g_queue_peek_head_link(waiting);
+}
+
+/**
+ * Insert a notification sorted into the given queue and register
+ * it in the id index. Behaves like g_queue_insert_sorted().
+ *
+ * @param queue The queue to insert the notification into
+ * @param n     The notification to insert
+ * @returns The link of the inserted notification
+ */
+static GList *queues_insert_sorted(GQueue *queue, struct notification *n)
+{
+        GList *sibling;
+
+        if (queue == waiting && settings.sort) {
+                sibling = queues_waiting_find_sibling(n);
+        } else {
+                sibling = g_queue_peek_head_link(queue);
+                while (sibling && notification_cmp_data(sibling->data, n, NULL) < 0)
+                        sibling = sibling->next;
+        }
+
+        g_queue_insert_before(queue, sibling, n);
+
+        GList *link = sibling ? sibling->prev : g_queue_peek_tail_link(queue);
+        queues_index_set(queue, link);
+
+        return link;
+}
+
+/**
+ * Remove the given link from the queue and from the id index.
+ *
+ * @param queue The queue, which contains `link`
+ * @param link  The link to remove
+ */
+static void queues_delete_link(GQueue *queue, GList *link)
+{
+        queues_index_remove(queue, link);
+        g_queue_delete_link(queue, link);
+}
+
+/**
+ * Replace the notification of the given link and keep the id index in sync.
+ *
+ * If the urgency changes in the sorted waiting queue, the new notification
+ * gets moved to its sorted position instead.
+ *
+ * @param queue The queue, which contains `link`
+ * @param link  The link to put the new notification in
+ * @param n     The new notification
+ */
+static void queues_replace_link_data(GQueue *queue, GList *link, struct notification *n)
+{
+        if (queue == waiting && settings.sort
+            && ((struct notification*)link->data)->urgency != n->urgency) {
+                queues_delete_link(queue, link);
+                queues_insert_sorted(queue, n);
+                return;
+        }
+
+        queues_index_remove(queue, link);
+        link->data = n;
+        queues_index_set(queue, link);
+}
+
 /**
  * Swap two given queue elements. The element's data has to be a notification.
  *
@@ -96,13 +554,13 @@ static void queues_swap_notifications(GQueue *queueA,
         struct notification *toB = elemA->data;
         struct notification *toA = elemB->data;
 
-        g_queue_delete_link(queueA, elemA);
-        g_queue_delete_link(queueB, elemB);
+        queues_delete_link(queueA, elemA);
+        queues_delete_link(queueB, elemB);
 
         if (toA)
-                g_queue_insert_sorted(queueA, toA, notification_cmp_data, NULL);
+                queues_insert_sorted(queueA, toA);
         if (toB)
-                g_queue_insert_sorted(queueB, toB, notification_cmp_data, NULL);
+                queues_insert_sorted(queueB, toB);
 }
 
 /**
@@ -124,44 +582,73 @@ static bool queues_notification_is_ready(const struct notification *n, struct du
 }
 
 /**
- * Check if a notification has timed out
+ * Hold back the notifications, which don't time out while the user is
+ * idle, or release them again with a fresh start time.
  *
- * @param n the notification to check
- * @param status the current status of dunst
- * @retval true: the notification is timed out
- * @retval false: otherwise
+ * @param pause If the user became idle
+ * @param now The current time
  */
-static bool queues_notification_is_finished(struct notification *n, struct dunst_status status)
+static void queues_expiry_pause(bool pause, gint64 now)
 {
-        assert(n);
+        GSequence *from = pause ? expiry : paused;
+        GSequence *to = pause ? paused : expiry;
+        GCompareDataFunc cmp = pause ? queues_timeout_cmp : queues_expiry_cmp;
+
+        GSequenceIter *iter = g_sequence_get_begin_iter(from);
+        while (!g_sequence_iter_is_end(iter)) {
+                GSequenceIter *next = g_sequence_iter_next(iter);
+                struct notification *n = g_sequence_get(iter);
+
+                if (queues_notification_pauses(n)) {
+                        if (!pause)
+                                n->start = now;
+                        /* Moving keeps the iterator in the queue entry valid */
+                        g_sequence_move(iter, g_sequence_search(to, n, cmp, NULL));
+                }
 
-        if (n->skip_display && !n->redisplayed)
-                return true;
+                iter = next;
+        }
 
-        if (n->timeout == 0) // sticky
-                return false;
+        expiry_paused = pause;
+}
 
+/**
+ * Close all displayed notifications, which have timed out.
+ *
+ * While the user is idle, only transient notifications time out. The
+ * others restart their timeout, once the user is back.
+ *
+ * @param status the current status of dunst
+ */
+static void queues_close_expired(struct dunst_status status)
+{
+        gint64 now = time_monotonic_now();
         bool is_idle = status.fullscreen ? false : status.idle;
 
-        /* don't timeout when user is idle */
-        if (is_idle && !n->transient) {
-                n->start = time_monotonic_now();
-                return false;
-        }
+        if (is_idle != expiry_paused)
+                queues_expiry_pause(is_idle, now);
 
-        /* remove old message */
-        if (time_monotonic_now() - n->start > n->timeout) {
-                return true;
-        }
+        GSequenceIter *iter = g_sequence_get_begin_iter(expiry);
+        while (!g_sequence_iter_is_end(iter)) {
+                struct notification *n = g_sequence_get(iter);
+
+                if (queues_notification_deadline(n) >= now)
+                        break;
+
+                iter = g_sequence_iter_next(iter);
 
-        return false;
+                if (notification_is_locked(n) || n->marked_for_closure)
+                        continue;
+
+                queues_notification_close(n, REASON_TIME);
+        }
 }
 
 /* see queues.h */
 int queues_notification_insert(struct notification *n)
 {
         /* do not display the message, if the message is empty */
-        if (STR_EMPTY(n->msg)) {
+        if (notification_msg_is_empty(n)) {
                 if (settings.always_run_script) {
                         notification_run_script(n);
                 }
@@ -173,7 +660,7 @@ int queues_notification_insert(struct notification *n)
         if (n->id != 0) {
                 if (!queues_notification_replace_id(n)) {
                         // Requested id was not valid, but play nice and assign it anyway
-                        g_queue_insert_sorted(waiting, n, notification_cmp_data, NULL);
+                        queues_insert_sorted(waiting, n);
                 }
                 inserted = true;
         } else {
@@ -187,7 +674,7 @@ int queues_notification_insert(struct notification *n)
                 inserted = true;
 
         if (!inserted)
-                g_queue_insert_sorted(waiting, n, notification_cmp_data, NULL);
+                queues_insert_sorted(waiting, n);
 
         if (settings.print_notifications)
                 notification_print(n);
@@ -203,35 +690,32 @@ int queues_notification_insert(struct notification *n)
  */
 static bool queues_stack_duplicate(struct notification *n)
 {
-        GQueue *allqueues[] = { displayed, waiting };
-        for (int i = 0; i < sizeof(allqueues)/sizeof(GQueue*); i++) {
-                for (GList *iter = g_queue_peek_head_link(allqueues[i]); iter;
-                     iter = iter->next) {
-                        struct notification *orig = iter->data;
-                        if (notification_is_duplicate(orig, n)) {
-                                /* If the progress differs, probably notify-send was used to update the notification
-                                 * So only count it as a duplicate, if the progress was not the same.
-                                 * */
-                                if (orig->progress == n->progress) {
-                                        orig->dup_count++;
-                                } else {
-                                        orig->progress = n->progress;
-                                }
-                                iter->data = n;
-
-                                n->dup_count = orig->dup_count;
-                                signal_notification_closed(orig, 1);
-
-                                if (allqueues[i] == displayed)
-                                        n->start = time_monotonic_now();
-
-                                notification_unref(orig);
-                                return true;
-                        }
-                }
+        GQueue *queue;
+        GList *link = queues_bucket_find(dup_index, n->fingerprint, n,
+                                         notification_is_duplicate, &queue);
+        if (!link)
+                return false;
+
+        struct notification *orig = link->data;
+        /* If the progress differs, probably notify-send was used to update the notification
+         * So only count it as a duplicate, if the progress was not the same.
+         * */
+        if (orig->progress == n->progress) {
+                orig->dup_count++;
+        } else {
+                orig->progress = n->progress;
         }
 
-        return false;
+        if (queue == displayed)
+                n->start = time_monotonic_now();
+
+        queues_replace_link_data(queue, link, n);
+
+        n->dup_count = orig->dup_count;
+        signal_notification_closed(orig, 1);
+
+        notification_unref(orig);
+        return true;
 }
 
 /**
@@ -242,54 +726,51 @@ static bool queues_stack_duplicate(struct notification *n)
  */
 static bool queues_stack_by_tag(struct notification *new)
 {
-        GQueue *allqueues[] = { displayed, waiting };
-        for (int i = 0; i < sizeof(allqueues)/sizeof(GQueue*); i++) {
-                for (GList *iter = g_queue_peek_head_link(allqueues[i]); iter;
-                            iter = iter->next) {
-                        struct notification *old = iter->data;
-                        if (STR_FULL(old->stack_tag) && STR_EQ(old->stack_tag, new->stack_tag)) {
-                                iter->data = new;
-                                new->dup_count = old->dup_count;
+        GQueue *queue;
+        GList *link = queues_bucket_find(tag_index, g_str_hash(new->stack_tag), new,
+                                         queues_stack_tag_equal, &queue);
+        if (!link)
+                return false;
 
-                                signal_notification_closed(old, 1);
+        struct notification *old = link->data;
 
-                                if (allqueues[i] == displayed) {
-                                        new->start = time_monotonic_now();
-                                        notification_run_script(new);
-                                }
+        if (queue == displayed)
+                new->start = time_monotonic_now();
 
-                                notification_unref(old);
-                                return true;
-                        }
-                }
-        }
-        return false;
+        queues_replace_link_data(queue, link, new);
+        new->dup_count = old->dup_count;
+
+        signal_notification_closed(old, 1);
+
+        if (queue == displayed)
+                notification_run_script(new);
+
+        notification_unref(old);
+        return true;
 }
 
 /* see queues.h */
 bool queues_notification_replace_id(struct notification *new)
 {
-        GQueue *allqueues[] = { displayed, waiting };
-        for (int i = 0; i < sizeof(allqueues)/sizeof(GQueue*); i++) {
-                for (GList *iter = g_queue_peek_head_link(allqueues[i]);
-                            iter;
-                            iter = iter->next) {
-                        struct notification *old = iter->data;
-                        if (old->id == new->id) {
-                                iter->data = new;
-                                new->dup_count = old->dup_count;
-
-                                if (allqueues[i] == displayed) {
-                                        new->start = time_monotonic_now();
-                                        notification_run_script(new);
-                                }
-
-                                notification_unref(old);
-                                return true;
-                        }
-                }
-        }
-        return false;
+        struct queue_entry *entry = queues_index_lookup(new->id);
+        if (!entry || entry->queue == history)
+                return false;
+
+        /* Replacing the link frees the entry */
+        GQueue *queue = entry->queue;
+        struct notification *old = entry->link->data;
+
+        if (queue == displayed)
+                new->start = time_monotonic_now();
+
+        queues_replace_link_data(queue, entry->link, new);
+        new->dup_count = old->dup_count;
+
+        if (queue == displayed)
+                notification_run_script(new);
+
+        notification_unref(old);
+        return true;
 }
 
 /* see queues.h */
@@ -297,17 +778,10 @@ void queues_notification_close_id(int id, enum reason reason)
 {
         struct notification *target = NULL;
 
-        GQueue *allqueues[] = { displayed, waiting };
-        for (int i = 0; i < sizeof(allqueues)/sizeof(GQueue*); i++) {
-                for (GList *iter = g_queue_peek_head_link(allqueues[i]); iter;
-                     iter = iter->next) {
-                        struct notification *n = iter->data;
-                        if (n->id == id) {
-                                g_queue_remove(allqueues[i], n);
-                                target = n;
-                                break;
-                        }
-                }
+        struct queue_entry *entry = queues_index_lookup(id);
+        if (entry && entry->queue != history) {
+                target = entry->link->data;
+                queues_delete_link(entry->queue, entry->link);
         }
 
         if (target) {
@@ -331,10 +805,11 @@ void queues_history_pop(void)
         if (g_queue_is_empty(history))
                 return;
 
-        struct notification *n = g_queue_pop_tail(history);
+        struct notification *n = g_queue_peek_tail(history);
+        queues_delete_link(history, g_queue_peek_tail_link(history));
         n->redisplayed = true;
         n->timeout = settings.sticky_history ? 0 : n->timeout;
-        g_queue_insert_sorted(waiting, n, notification_cmp_data, NULL);
+        queues_insert_sorted(waiting, n);
 }
 
 /* see queues.h */
@@ -342,11 +817,13 @@ void queues_history_push(struct notification *n)
 {
         if (!n->history_ignore) {
                 if (settings.history_length > 0 && history->length >= settings.history_length) {
-                        struct notification *to_free = g_queue_pop_head(history);
+                        struct notification *to_free = g_queue_peek_head(history);
+                        queues_delete_link(history, g_queue_peek_head_link(history));
                         notification_unref(to_free);
                 }
 
                 g_queue_push_tail(history, n);
+                queues_index_set(history, g_queue_peek_tail_link(history));
         } else {
                 notification_unref(n);
         }
@@ -369,6 +846,8 @@ void queues_update(struct dunst_status status)
 {
         GList *iter, *nextiter;
 
+        queues_close_expired(status);
+
         /* Move back all notifications, which aren't eligible to get shown anymore
          * Will move the notifications back to waiting, if dunst isn't running or fullscreen
          * and notifications is not eligible to get shown anymore */
@@ -390,15 +869,9 @@ void queues_update(struct dunst_status status)
                 }
 
 
-                if (queues_notification_is_finished(n, status)){
-                        queues_notification_close(n, REASON_TIME);
-                        iter = nextiter;
-                        continue;
-                }
-
                 if (!queues_notification_is_ready(n, status, true)) {
-                        g_queue_delete_link(displayed, iter);
-                        g_queue_insert_sorted(waiting, n, notification_cmp_data, NULL);
+                        queues_delete_link(displayed, iter);
+                        queues_insert_sorted(waiting, n);
                         iter = nextiter;
                         continue;
                 }
@@ -416,8 +889,12 @@ void queues_update(struct dunst_status status)
         else
                 cur_displayed_limit = settings.geometry.h;
 
-        /* move notifications from queue to displayed */
-        iter = g_queue_peek_head_link(waiting);
+        /* move notifications from queue to displayed
+         * Skip scanning waiting, if none of its notifications is ready anyways */
+        if (!status.running || (status.fullscreen && waiting_fs_show == 0))
+                iter = NULL;
+        else
+                iter = g_queue_peek_head_link(waiting);
         while (displayed->length < cur_displayed_limit && iter) {
                 struct notification *n = iter->data;
                 nextiter = iter->next;
@@ -435,8 +912,8 @@ void queues_update(struct dunst_status status)
                 if (n->skip_display && !n->redisplayed) {
                         queues_notification_close(n, REASON_USER);
                 } else {
-                        g_queue_delete_link(waiting, iter);
-                        g_queue_insert_sorted(displayed, n, notification_cmp_data, NULL);
+                        queues_delete_link(waiting, iter);
+                        queues_insert_sorted(displayed, n);
                 }
 
                 iter = nextiter;
@@ -444,8 +921,9 @@ void queues_update(struct dunst_status status)
 
         /* if necessary, push the overhanging notifications from displayed to waiting again */
         while (displayed->length > cur_displayed_limit) {
-                struct notification *n = g_queue_pop_tail(displayed);
-                g_queue_insert_sorted(waiting, n, notification_cmp_data, NULL); //TODO: actually it should be on the head if unsorted
+                struct notification *n = g_queue_peek_tail(displayed);
+                queues_delete_link(displayed, g_queue_peek_tail_link(displayed));
+                queues_insert_sorted(waiting, n); //TODO: actually it should be on the head if unsorted
         }
 
         /* If displayed is actually full, let the more important notifications
@@ -480,20 +958,26 @@ gint64 queues_get_next_datachange(gint64 time)
 {
         gint64 sleep = G_MAXINT64;
 
-        for (GList *iter = g_queue_peek_head_link(displayed); iter;
-                        iter = iter->next) {
-                struct notification *n = iter->data;
-                gint64 ttl = n->timeout - (time - n->start);
+        GSequenceIter *next = g_sequence_get_begin_iter(expiry);
+        if (!g_sequence_iter_is_end(next)) {
+                gint64 deadline = queues_notification_deadline(g_sequence_get(next));
 
-                if (n->timeout > 0) {
-                        if (ttl > 0)
-                                sleep = MIN(sleep, ttl);
-                        else
-                                // while we're processing, the notification already timed out
-                                return 0;
-                }
+                if (deadline > time)
+                        sleep = deadline - time;
+                else
+                        // while we're processing, the notification already timed out
+                        return 0;
+        }
 
-                if (settings.show_age_threshold >= 0) {
+        /* Wake up to notice, when the user isn't idle anymore */
+        GSequenceIter *held = g_sequence_get_begin_iter(paused);
+        if (!g_sequence_iter_is_end(held))
+                sleep = MIN(sleep, ((struct notification *) g_sequence_get(held))->timeout);
+
+        if (settings.show_age_threshold >= 0) {
+                for (GList *iter = g_queue_peek_head_link(displayed); iter;
+                                iter = iter->next) {
+                        struct notification *n = iter->data;
                         gint64 age = time - n->timestamp;
 
                         // sleep exactly until the next shift of the second happens
@@ -515,17 +999,9 @@ struct notification* queues_get_by_id(int id)
 {
         assert(id > 0);
 
-        GQueue *recqueues[] = { displayed, waiting, history };
-        for (int i = 0; i < sizeof(recqueues)/sizeof(GQueue*); i++) {
-                for (GList *iter = g_queue_peek_head_link(recqueues[i]); iter;
-                     iter = iter->next) {
-                        struct notification *cur = iter->data;
-                        if (cur->id == id)
-                                return cur;
-                }
-        }
+        struct queue_entry *entry = queues_index_lookup(id);
 
-        return NULL;
+        return entry ? entry->link->data : NULL;
 }
 
 /**
@@ -542,6 +1018,12 @@ static void teardown_notification(gpointer data)
 /* see queues.h */
 void queues_teardown(void)
 {
+        g_clear_pointer(&id_index, g_hash_table_unref);
+        g_clear_pointer(&tag_index, g_hash_table_unref);
+        g_clear_pointer(&dup_index, g_hash_table_unref);
+        g_clear_pointer(&expiry, g_sequence_free);
+        g_clear_pointer(&paused, g_sequence_free);
+
         g_queue_free_full(history, teardown_notification);
         history = NULL;
         g_queue_free_full(displayed, teardown_notification);
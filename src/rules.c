@@ -4,16 +4,67 @@
 
 #include <fnmatch.h>
 #include <glib.h>
+#include <string.h>
+#include <time.h>
 
 #include "dunst.h"
+#include "log.h"
+#include "utils.h"
 
 GSList *rules = NULL;
 
+/** The filters, whose literal patterns get indexed, in order of preference */
+enum rule_index_field {
+        RULE_INDEX_APPNAME,
+        RULE_INDEX_DESKTOP_ENTRY,
+        RULE_INDEX_CATEGORY,
+        RULE_INDEX_STACK_TAG,
+        RULE_INDEX_FIELDS,
+};
+
+//!< The compiled form of #rules
+struct rule_index {
+        GPtrArray *rules;       //!< All rules by their position in #rules
+        /** For every indexed filter the positions of the rules with a literal
+         * pattern by the pattern: char* -> GArray* of guint */
+        GHashTable *literals[RULE_INDEX_FIELDS];
+        GArray *others;         //!< The positions of the rules without any literal filter
+};
+
+static struct rule_index *rule_index = NULL;
+
+/** The maximum amount of signatures in #rule_cache */
+#define RULE_CACHE_SIZE 128
+
+//!< The fields of a notification, which are the same for most messages of an application
+struct rule_signature {
+        char *appname;
+        char *category;
+        char *desktop_entry;
+        enum urgency urgency;
+        bool transient;
+};
+
+//!< The rules matching a signature
+struct rule_cache_entry {
+        struct rule_signature sig;
+        GArray *matches;        //!< The positions of the matching rules in ascending order
+        GList order;            //!< Link in #rule_cache_order, data points to the entry
+};
+
+/** The rules by signature: struct rule_signature* -> struct rule_cache_entry* */
+static GHashTable *rule_cache = NULL;
+/** The entries of #rule_cache, the most recently used first */
+static GQueue rule_cache_order = G_QUEUE_INIT;
+static struct rule_cache_stats rule_cache_stats = { 0, 0 };
+
 /*
  * Apply rule to notification.
  */
 void rule_apply(struct rule *r, struct notification *n)
 {
+        r->stats.applies++;
+
         if (r->timeout != -1)
                 n->timeout = r->timeout;
         if (r->urgency != URG_NONE)
@@ -29,23 +80,8 @@ void rule_apply(struct rule *r, struct notification *n)
         if (r->markup != MARKUP_NULL)
                 n->markup = r->markup;
         if (r->new_icon)
-                notification_icon_replace_path(n, r->new_icon);
-        if (r->fg) {
-                g_free(n->colors.fg);
-                n->colors.fg = g_strdup(r->fg);
-        }
-        if (r->bg) {
-                g_free(n->colors.bg);
-                n->colors.bg = g_strdup(r->bg);
-        }
-        if (r->highlight) {
-                g_free(n->colors.highlight);
-                n->colors.highlight = g_strdup(r->highlight);
-        }
-        if (r->fc) {
-                g_free(n->colors.frame);
-                n->colors.frame = g_strdup(r->fc);
-        }
+                notification_icon_set_name(n, r->new_icon);
+        notification_colors_merge(&n->colors, &r->colors);
         if (r->format)
                 n->format = r->format;
         if (r->script){
@@ -60,17 +96,399 @@ void rule_apply(struct rule *r, struct notification *n)
         }
 }
 
+static inline bool rule_field_matches_string(const char *value, const char *pattern)
+{
+        return !pattern || (value && !fnmatch(pattern, value, 0));
+}
+
 /*
- * Check all rules if they match n and apply.
+ * Check whether the filters of the rule on the signature fields match n.
  */
-void rule_apply_all(struct notification *n)
+static bool rule_matches_signature(const struct rule *r, const struct notification *n)
+{
+        return     (r->msg_urgency == URG_NONE || r->msg_urgency == n->urgency)
+                && (r->match_transient == -1 || (r->match_transient == n->transient))
+                && rule_field_matches_string(n->appname,        r->appname)
+                && rule_field_matches_string(n->desktop_entry,  r->desktop_entry)
+                && rule_field_matches_string(n->category,       r->category);
+}
+
+/*
+ * Check whether the filters of the rule on the remaining fields match n.
+ */
+static bool rule_matches_message(const struct rule *r, const struct notification *n)
+{
+        return     rule_field_matches_string(n->summary,        r->summary)
+                && rule_field_matches_string(n->body,           r->body)
+                && rule_field_matches_string(n->iconname,       r->icon)
+                && rule_field_matches_string(n->stack_tag,      r->stack_tag);
+}
+
+/**
+ * Get a monotonic timestamp in nanoseconds for #rule_stats.eval_time
+ */
+static inline guint64 rule_clock(void)
+{
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return (guint64) now.tv_sec * G_GUINT64_CONSTANT(1000000000) + now.tv_nsec;
+}
+
+/**
+ * Check the filters of the rule on the signature fields and account the
+ * time spent in the stats of the rule.
+ */
+static bool rule_eval_signature(struct rule *r, const struct notification *n)
+{
+        guint64 start = rule_clock();
+        bool matches = rule_matches_signature(r, n);
+        r->stats.eval_time += rule_clock() - start;
+        return matches;
+}
+
+/**
+ * Check the filters of the rule on the remaining fields and account the
+ * check, the match and the time spent in the stats of the rule.
+ *
+ * As the filters on the signature fields are only checked once per
+ * signature, this counts as the evaluation of the rule against n.
+ */
+static bool rule_eval_message(struct rule *r, const struct notification *n)
+{
+        guint64 start = rule_clock();
+        bool matches = rule_matches_message(r, n);
+        r->stats.eval_time += rule_clock() - start;
+
+        r->stats.checks++;
+        if (matches)
+                r->stats.matches++;
+        return matches;
+}
+
+/**
+ * Check if a pattern only matches the string equal to it
+ */
+static bool rule_pattern_is_literal(const char *pattern)
+{
+        return !strpbrk(pattern, "*?[\\");
+}
+
+/**
+ * Get the pattern of an indexed filter of a rule
+ */
+static const char *rule_index_pattern(const struct rule *r, enum rule_index_field field)
+{
+        switch (field) {
+        case RULE_INDEX_APPNAME:        return r->appname;
+        case RULE_INDEX_DESKTOP_ENTRY:  return r->desktop_entry;
+        case RULE_INDEX_CATEGORY:       return r->category;
+        case RULE_INDEX_STACK_TAG:      return r->stack_tag;
+        default:                        return NULL;
+        }
+}
+
+/**
+ * Get the value of an indexed filter of a notification
+ */
+static const char *rule_index_value(const struct notification *n, enum rule_index_field field)
+{
+        switch (field) {
+        case RULE_INDEX_APPNAME:        return n->appname;
+        case RULE_INDEX_DESKTOP_ENTRY:  return n->desktop_entry;
+        case RULE_INDEX_CATEGORY:       return n->category;
+        case RULE_INDEX_STACK_TAG:      return n->stack_tag;
+        default:                        return NULL;
+        }
+}
+
+static void rule_index_free(struct rule_index *index)
+{
+        for (int f = 0; f < RULE_INDEX_FIELDS; f++)
+                g_hash_table_unref(index->literals[f]);
+        g_ptr_array_unref(index->rules);
+        g_array_unref(index->others);
+        g_free(index);
+}
+
+static guint rule_signature_hash(gconstpointer key)
+{
+        const struct rule_signature *sig = key;
+        guint hash = sig->urgency * 2 + sig->transient;
+
+        hash = hash * 31 + (sig->appname ? g_str_hash(sig->appname) : 0);
+        hash = hash * 31 + (sig->category ? g_str_hash(sig->category) : 0);
+        hash = hash * 31 + (sig->desktop_entry ? g_str_hash(sig->desktop_entry) : 0);
+        return hash;
+}
+
+static gboolean rule_signature_equal(gconstpointer a, gconstpointer b)
+{
+        const struct rule_signature *sa = a;
+        const struct rule_signature *sb = b;
+
+        return sa->urgency == sb->urgency
+            && sa->transient == sb->transient
+            && STR_EQ(sa->appname, sb->appname)
+            && STR_EQ(sa->category, sb->category)
+            && STR_EQ(sa->desktop_entry, sb->desktop_entry);
+}
+
+static void rule_cache_entry_free(gpointer data)
+{
+        struct rule_cache_entry *entry = data;
+
+        g_queue_unlink(&rule_cache_order, &entry->order);
+        g_free(entry->sig.appname);
+        g_free(entry->sig.category);
+        g_free(entry->sig.desktop_entry);
+        g_array_unref(entry->matches);
+        g_free(entry);
+}
+
+static void rule_cache_clear(void)
 {
+        g_clear_pointer(&rule_cache, g_hash_table_unref);
+}
+
+/* see rules.h */
+void rules_compile(void)
+{
+        struct rule_index *index = g_malloc0(sizeof(struct rule_index));
+        int indexed = 0;
+
+        index->rules = g_ptr_array_new();
+        index->others = g_array_new(FALSE, FALSE, sizeof(guint));
+        for (int f = 0; f < RULE_INDEX_FIELDS; f++)
+                index->literals[f] = g_hash_table_new_full(g_str_hash,
+                                                           g_str_equal,
+                                                           g_free,
+                                                           (GDestroyNotify) g_array_unref);
+
         for (GSList *iter = rules; iter; iter = iter->next) {
                 struct rule *r = iter->data;
-                if (rule_matches_notification(r, n)) {
-                        rule_apply(r, n);
+                guint pos = index->rules->len;
+                GArray *bucket = index->others;
+
+                g_ptr_array_add(index->rules, r);
+
+                /* A rule can only match, if all its filters match. So it's
+                 * sufficient to put it into the bucket of a single filter. */
+                for (int f = 0; f < RULE_INDEX_FIELDS; f++) {
+                        const char *pattern = rule_index_pattern(r, f);
+                        if (!pattern || !rule_pattern_is_literal(pattern))
+                                continue;
+
+                        bucket = g_hash_table_lookup(index->literals[f], pattern);
+                        if (!bucket) {
+                                bucket = g_array_new(FALSE, FALSE, sizeof(guint));
+                                g_hash_table_insert(index->literals[f], g_strdup(pattern), bucket);
+                        }
+                        indexed++;
+                        break;
+                }
+
+                g_array_append_val(bucket, pos);
+        }
+
+        LOG_D("Compiled %u rules, %d of them got indexed by a literal filter",
+              index->rules->len, indexed);
+
+        if (rule_index)
+                rule_index_free(rule_index);
+        rule_index = index;
+
+        rule_cache_clear();
+}
+
+/* see rules.h */
+void rules_teardown(void)
+{
+        rule_cache_clear();
+        g_clear_pointer(&rule_index, rule_index_free);
+}
+
+/**
+ * Look up the positions of the rules with a literal filter matching the
+ * notification.
+ *
+ * @return the positions in ascending order or NULL if there is no such rule
+ */
+static GArray *rule_index_lookup(const struct notification *n, enum rule_index_field field)
+{
+        const char *value = rule_index_value(n, field);
+
+        return value ? g_hash_table_lookup(rule_index->literals[field], value) : NULL;
+}
+
+static gint rule_position_cmp(gconstpointer a, gconstpointer b)
+{
+        guint pa = *(const guint *)a;
+        guint pb = *(const guint *)b;
+
+        return (pa > pb) - (pa < pb);
+}
+
+/**
+ * Collect all rules, whose filters on the signature fields match the
+ * notification. Only the rules from the index, which may match, get
+ * checked.
+ *
+ * @return the positions of the rules in ascending order
+ */
+static GArray *rule_signature_matches(const struct notification *n)
+{
+        GArray *candidates = g_array_new(FALSE, FALSE, sizeof(guint));
+
+        /* The stack tag isn't part of the signature, the rules indexed
+         * by it get looked up per message in rule_apply_all() */
+        for (int f = 0; f < RULE_INDEX_FIELDS; f++) {
+                if (f == RULE_INDEX_STACK_TAG)
+                        continue;
+                GArray *bucket = rule_index_lookup(n, f);
+                if (bucket)
+                        g_array_append_vals(candidates, bucket->data, bucket->len);
+        }
+
+        g_array_append_vals(candidates, rule_index->others->data, rule_index->others->len);
+        g_array_sort(candidates, rule_position_cmp);
+
+        GArray *matches = g_array_new(FALSE, FALSE, sizeof(guint));
+        for (guint i = 0; i < candidates->len; i++) {
+                guint pos = g_array_index(candidates, guint, i);
+                if (rule_eval_signature(g_ptr_array_index(rule_index->rules, pos), n))
+                        g_array_append_val(matches, pos);
+        }
+
+        g_array_unref(candidates);
+        return matches;
+}
+
+/**
+ * Get the rules matching the signature of the notification from the cache
+ * or compute them.
+ *
+ * @return a new reference to the positions of the rules in ascending order
+ */
+static GArray *rule_cache_get(const struct notification *n)
+{
+        struct rule_signature sig = {
+                .appname = n->appname,
+                .category = n->category,
+                .desktop_entry = n->desktop_entry,
+                .urgency = n->urgency,
+                .transient = n->transient,
+        };
+
+        if (!rule_cache)
+                rule_cache = g_hash_table_new_full(rule_signature_hash,
+                                                   rule_signature_equal,
+                                                   NULL,
+                                                   rule_cache_entry_free);
+
+        struct rule_cache_entry *entry = g_hash_table_lookup(rule_cache, &sig);
+        if (entry) {
+                rule_cache_stats.hits++;
+                g_queue_unlink(&rule_cache_order, &entry->order);
+                g_queue_push_head_link(&rule_cache_order, &entry->order);
+                return g_array_ref(entry->matches);
+        }
+        rule_cache_stats.misses++;
+
+        if (g_hash_table_size(rule_cache) >= RULE_CACHE_SIZE) {
+                struct rule_cache_entry *oldest = g_queue_peek_tail(&rule_cache_order);
+                g_hash_table_remove(rule_cache, &oldest->sig);
+        }
+
+        entry = g_malloc(sizeof(struct rule_cache_entry));
+        entry->sig = sig;
+        entry->sig.appname = g_strdup(sig.appname);
+        entry->sig.category = g_strdup(sig.category);
+        entry->sig.desktop_entry = g_strdup(sig.desktop_entry);
+        entry->matches = rule_signature_matches(n);
+        entry->order.data = entry;
+        entry->order.prev = NULL;
+        entry->order.next = NULL;
+
+        g_hash_table_insert(rule_cache, &entry->sig, entry);
+        g_queue_push_head_link(&rule_cache_order, &entry->order);
+
+        return g_array_ref(entry->matches);
+}
+
+/* see rules.h */
+struct rule_cache_stats rule_cache_stats_get(void)
+{
+        return rule_cache_stats;
+}
+
+/**
+ * Find the first of the positions after @p pos.
+ *
+ * @param positions (nullable) The positions in ascending order
+ * @return the index into @p positions
+ */
+static guint rule_positions_after(const GArray *positions, guint pos)
+{
+        guint i = 0;
+
+        while (positions && i < positions->len && g_array_index(positions, guint, i) <= pos)
+                i++;
+        return i;
+}
+
+/*
+ * Check all rules if they match n and apply.
+ *
+ * The rules matching the signature of the notification are taken from
+ * the cache, so only the filters on the message itself have to get
+ * checked. The rules indexed by the stack tag of the notification get
+ * merged in by their position, so the rules get applied in the order of
+ * the dunstrc.
+ */
+void rule_apply_all(struct notification *n)
+{
+        if (!rule_index)
+                rules_compile();
+
+        GArray *matches = rule_cache_get(n);
+        GArray *tagged = rule_index_lookup(n, RULE_INDEX_STACK_TAG);
+        guint i = 0, t = 0;
+
+        for (;;) {
+                bool by_tag = tagged && t < tagged->len
+                           && (i >= matches->len
+                               || g_array_index(tagged, guint, t) < g_array_index(matches, guint, i));
+                if (!by_tag && i >= matches->len)
+                        break;
+
+                guint pos = by_tag ? g_array_index(tagged, guint, t++)
+                                   : g_array_index(matches, guint, i++);
+                struct rule *r = g_ptr_array_index(rule_index->rules, pos);
+
+                if (by_tag && !rule_eval_signature(r, n))
+                        continue;
+                if (!rule_eval_message(r, n))
+                        continue;
+
+                enum urgency urgency = n->urgency;
+                bool transient = n->transient;
+                rule_apply(r, n);
+
+                /* Rules after this one may match the new signature */
+                if (n->urgency != urgency || n->transient != transient) {
+                        g_array_unref(matches);
+                        matches = rule_cache_get(n);
+                        i = rule_positions_after(matches, pos);
+                }
+
+                /* or the new stack tag */
+                if (r->set_stack_tag) {
+                        tagged = rule_index_lookup(n, RULE_INDEX_STACK_TAG);
+                        t = rule_positions_after(tagged, pos);
                 }
         }
+
+        g_array_unref(matches);
 }
 
 struct rule *rule_new(void)
@@ -90,24 +508,11 @@ struct rule *rule_new(void)
         return r;
 }
 
-static inline bool rule_field_matches_string(const char *value, const char *pattern)
-{
-        return !pattern || (value && !fnmatch(pattern, value, 0));
-}
-
 /*
  * Check whether rule should be applied to n.
  */
 bool rule_matches_notification(struct rule *r, struct notification *n)
 {
-        return     (r->msg_urgency == URG_NONE || r->msg_urgency == n->urgency)
-                && (r->match_transient == -1 || (r->match_transient == n->transient))
-                && rule_field_matches_string(n->appname,        r->appname)
-                && rule_field_matches_string(n->desktop_entry,  r->desktop_entry)
-                && rule_field_matches_string(n->summary,        r->summary)
-                && rule_field_matches_string(n->body,           r->body)
-                && rule_field_matches_string(n->iconname,       r->icon)
-                && rule_field_matches_string(n->category,       r->category)
-                && rule_field_matches_string(n->stack_tag,      r->stack_tag);
+        return rule_eval_signature(r, n) && rule_eval_message(r, n);
 }
 /* vim: set ft=c tabstop=8 shiftwidth=8 expandtab textwidth=0: */
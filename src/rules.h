@@ -8,6 +8,14 @@
 #include "notification.h"
 #include "settings.h"
 
+//!< Counters about the evaluation of a single rule
+struct rule_stats {
+        guint64 checks;         //!< How often the rule got checked against a notification matching its signature filters
+        guint64 matches;        //!< How often all filters matched a notification
+        guint64 applies;        //!< How often the rule got applied to a notification
+        guint64 eval_time;      //!< Cumulative time spent evaluating the filters in nanoseconds
+};
+
 struct rule {
         char *name;
         /* filters */
@@ -29,14 +37,13 @@ struct rule {
         int set_transient;
         int skip_display;
         char *new_icon;
-        char *fg;
-        char *bg;
-        char *highlight;
-        char *fc;
+        struct notification_colors colors;
         const char *format;
         const char *script;
         enum behavior_fullscreen fullscreen;
         char *set_stack_tag;
+
+        struct rule_stats stats;
 };
 
 extern GSList *rules;
@@ -52,5 +59,37 @@ void rule_apply(struct rule *r, struct notification *n);
 void rule_apply_all(struct notification *n);
 bool rule_matches_notification(struct rule *r, struct notification *n);
 
+/**
+ * Compile #rules into the index used by rule_apply_all().
+ *
+ * Filters on appname, desktop_entry, category and stack_tag without any
+ * glob characters get looked up in hash tables instead of getting matched
+ * against every notification.
+ *
+ * Has to be called again after modifying #rules or any rule in it. Clears
+ * the cache of matching rules.
+ */
+void rules_compile(void);
+
+/**
+ * Free the index of #rules and the cache of matching rules
+ */
+void rules_teardown(void);
+
+//!< Counters of the lookups in the cache of matching rules
+struct rule_cache_stats {
+        guint64 hits;   //!< Notifications, whose signature was cached
+        guint64 misses; //!< Notifications, for which all rules had to be checked
+};
+
+/**
+ * Get the current counters of the cache of matching rules.
+ *
+ * The cache maps the signature of a notification (appname, category,
+ * desktop_entry, urgency and transient) to the rules, whose filters on
+ * these fields match. It gets cleared by rules_compile().
+ */
+struct rule_cache_stats rule_cache_stats_get(void);
+
 #endif
 /* vim: set ft=c tabstop=8 shiftwidth=8 expandtab textwidth=0: */
@@ -34,6 +34,24 @@ static enum urgency ini_get_urgency(const char *section, const char *key, const
         return ret;
 }
 
+/**
+ * Parse the color of a rule
+ *
+ * @param ret The color packed as 0xRRGGBBAA, untouched if the color is not set or invalid
+ * @returns if ret got set
+ */
+static bool ini_get_color(const char *section, const char *key, uint32_t *ret)
+{
+        char *c = ini_get_string(section, key, NULL);
+        bool valid = string_parse_color(c, ret);
+
+        if (c && !valid)
+                LOG_W("Invalid color in section '%s': '%s'", section, c);
+
+        g_free(c);
+        return valid;
+}
+
 static FILE *xdg_config(const char *filename)
 {
         const gchar * const * systemdirs = g_get_system_config_dirs();
@@ -456,6 +474,17 @@ void load_settings(char *cmdline_config_path)
                 "print notification on startup"
         );
 
+        settings.max_redraw_rate = option_get_int(
+                "global",
+                "max_redraw_rate", "-max_redraw_rate", defaults.max_redraw_rate,
+                "Maximum amount of redraws per second"
+        );
+
+        if (settings.max_redraw_rate < 0) {
+                LOG_W("Setting max_redraw_rate to a negative value is not allowed. Disabling the limit.");
+                settings.max_redraw_rate = 0;
+        }
+
         settings.dmenu = option_get_path(
                 "global",
                 "dmenu", "-dmenu", defaults.dmenu,
@@ -585,6 +614,23 @@ void load_settings(char *cmdline_config_path)
                 "paths to default icons"
         );
 
+        settings.icon_theme = option_get_string(
+                "global",
+                "icon_theme", "-icon_theme", defaults.icon_theme,
+                "Name of the icon theme to look up icons in"
+        );
+
+        settings.icon_cache_size = option_get_int(
+                "global",
+                "icon_cache_size", "-icon_cache_size", defaults.icon_cache_size,
+                "Memory in kilobytes to keep decoded icons in, set to 0 to disable"
+        );
+
+        if (settings.icon_cache_size < 0) {
+                LOG_W("Setting icon_cache_size to a negative value is not allowed. Disabling the icon cache.");
+                settings.icon_cache_size = 0;
+        }
+
         {
                 // Backwards compatibility with the legacy 'frame' section.
                 if (ini_is_set("frame", "width")) {
@@ -664,27 +710,34 @@ void load_settings(char *cmdline_config_path)
                 free_string_array(c);
         }
 
-        settings.colors_low.bg = option_get_string(
+        /* The global frame color is the default of the urgency sections */
+        uint32_t frame_color;
+        if (!string_parse_color(settings.frame_color, &frame_color)) {
+                LOG_W("Invalid frame color: '%s'", settings.frame_color);
+                string_parse_color(defaults.frame_color, &frame_color);
+        }
+
+        settings.colors_low.bg = option_get_color(
                 "urgency_low",
                 "background", "-lb", defaults.colors_low.bg,
                 "Background color for notifications with low urgency"
         );
 
-        settings.colors_low.fg = option_get_string(
+        settings.colors_low.fg = option_get_color(
                 "urgency_low",
                 "foreground", "-lf", defaults.colors_low.fg,
                 "Foreground color for notifications with low urgency"
         );
 
-        settings.colors_low.highlight = option_get_string(
+        settings.colors_low.highlight = option_get_color(
                 "urgency_low",
                 "highlight", "-lh", defaults.colors_low.highlight,
                 "Highlight color for notifications with low urgency"
         );
 
-        settings.colors_low.frame = option_get_string(
+        settings.colors_low.frame = option_get_color(
                 "urgency_low",
-                "frame_color", "-lfr", settings.frame_color ? settings.frame_color : defaults.colors_low.frame,
+                "frame_color", "-lfr", frame_color,
                 "Frame color for notifications with low urgency"
         );
 
@@ -700,27 +753,27 @@ void load_settings(char *cmdline_config_path)
                 "Icon for notifications with low urgency"
         );
 
-        settings.colors_norm.bg = option_get_string(
+        settings.colors_norm.bg = option_get_color(
                 "urgency_normal",
                 "background", "-nb", defaults.colors_norm.bg,
                 "Background color for notifications with normal urgency"
         );
 
-        settings.colors_norm.fg = option_get_string(
+        settings.colors_norm.fg = option_get_color(
                 "urgency_normal",
                 "foreground", "-nf", defaults.colors_norm.fg,
                 "Foreground color for notifications with normal urgency"
         );
 
-        settings.colors_norm.highlight = option_get_string(
+        settings.colors_norm.highlight = option_get_color(
                 "urgency_normal",
                 "highlight", "-nh", defaults.colors_norm.highlight,
                 "Highlight color for notifications with normal urgency"
         );
 
-        settings.colors_norm.frame = option_get_string(
+        settings.colors_norm.frame = option_get_color(
                 "urgency_normal",
-                "frame_color", "-nfr", settings.frame_color ? settings.frame_color : defaults.colors_norm.frame,
+                "frame_color", "-nfr", frame_color,
                 "Frame color for notifications with normal urgency"
         );
 
@@ -736,27 +789,27 @@ void load_settings(char *cmdline_config_path)
                 "Icon for notifications with normal urgency"
         );
 
-        settings.colors_crit.bg = option_get_string(
+        settings.colors_crit.bg = option_get_color(
                 "urgency_critical",
                 "background", "-cb", defaults.colors_crit.bg,
                 "Background color for notifications with critical urgency"
         );
 
-        settings.colors_crit.fg = option_get_string(
+        settings.colors_crit.fg = option_get_color(
                 "urgency_critical",
                 "foreground", "-cf", defaults.colors_crit.fg,
                 "Foreground color for notifications with ciritical urgency"
         );
 
-        settings.colors_crit.highlight = option_get_string(
+        settings.colors_crit.highlight = option_get_color(
                 "urgency_critical",
                 "highlight", "-ch", defaults.colors_crit.highlight,
                 "Highlight color for notifications with ciritical urgency"
         );
 
-        settings.colors_crit.frame = option_get_string(
+        settings.colors_crit.frame = option_get_color(
                 "urgency_critical",
-                "frame_color", "-cfr", settings.frame_color ? settings.frame_color : defaults.colors_crit.frame,
+                "frame_color", "-cfr", frame_color,
                 "Frame color for notifications with critical urgency"
         );
 
@@ -864,10 +917,14 @@ void load_settings(char *cmdline_config_path)
 
                 r->urgency = ini_get_urgency(cur_section, "urgency", r->urgency);
                 r->msg_urgency = ini_get_urgency(cur_section, "msg_urgency", r->msg_urgency);
-                r->fg = ini_get_string(cur_section, "foreground", r->fg);
-                r->bg = ini_get_string(cur_section, "background", r->bg);
-                r->highlight = ini_get_string(cur_section, "highlight", r->highlight);
-                r->fc = ini_get_string(cur_section, "frame_color", r->fc);
+                if (ini_get_color(cur_section, "foreground", &r->colors.fg))
+                        r->colors.set |= COLOR_FG;
+                if (ini_get_color(cur_section, "background", &r->colors.bg))
+                        r->colors.set |= COLOR_BG;
+                if (ini_get_color(cur_section, "highlight", &r->colors.highlight))
+                        r->colors.set |= COLOR_HIGHLIGHT;
+                if (ini_get_color(cur_section, "frame_color", &r->colors.frame))
+                        r->colors.set |= COLOR_FRAME;
                 r->format = ini_get_string(cur_section, "format", r->format);
                 r->new_icon = ini_get_string(cur_section, "new_icon", r->new_icon);
                 r->history_ignore = ini_get_bool(cur_section, "history_ignore", r->history_ignore);
@@ -891,6 +948,8 @@ void load_settings(char *cmdline_config_path)
                 r->set_stack_tag = ini_get_string(cur_section, "set_stack_tag", r->set_stack_tag);
         }
 
+        rules_compile();
+
 #ifndef STATIC_CONFIG
         if (config_file) {
                 fclose(config_file);
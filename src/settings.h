@@ -32,7 +32,7 @@ enum zwlr_layer_shell_v1_layer {
 
 struct separator_color_data {
         enum separator_color type;
-        char *sep_color;
+        uint32_t sep_color;     //!< The color of SEP_CUSTOM, packed as 0xRRGGBBAA
 };
 
 struct geometry {
@@ -86,6 +86,7 @@ struct settings {
         int frame_width;
         char *frame_color;
         int startup_notification;
+        int max_redraw_rate;
         int monitor;
         char *dmenu;
         char **dmenu_cmd;
@@ -96,6 +97,8 @@ struct settings {
         int min_icon_size;
         int max_icon_size;
         char *icon_path;
+        char *icon_theme;
+        int icon_cache_size;
         enum follow_mode f_mode;
         bool always_run_script;
         struct keyboard_shortcut close_ks;
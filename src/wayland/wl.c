@@ -81,6 +81,11 @@ struct wl_ctx {
         int32_t width, height;
         struct pool_buffer buffers[2];
         struct pool_buffer *current_buffer;
+
+        // The damaged areas of the surface since the last frame and the
+        // outdated areas of the buffers. NULL means everything.
+        cairo_region_t *damage;
+        cairo_region_t *buffer_damage[2];
 };
 
 struct dunst_output {
@@ -584,6 +589,10 @@ void wl_deinit() {
         finish_buffer(&ctx.buffers[0]);
         finish_buffer(&ctx.buffers[1]);
 
+        g_clear_pointer(&ctx.damage, cairo_region_destroy);
+        g_clear_pointer(&ctx.buffer_damage[0], cairo_region_destroy);
+        g_clear_pointer(&ctx.buffer_damage[1], cairo_region_destroy);
+
         // The output list is initialized at the start of init, so no need to
         // check for NULL
         struct dunst_output *output, *output_tmp;
@@ -665,6 +674,9 @@ static void send_frame() {
                 ctx.surface = wl_compositor_create_surface(ctx.compositor);
                 wl_surface_add_listener(ctx.surface, &surface_listener, NULL);
 
+                // The first buffer of a new surface has to be damaged entirely
+                g_clear_pointer(&ctx.damage, cairo_region_destroy);
+
                 if (settings.frame_color)
                 ctx.layer_surface = zwlr_layer_shell_v1_get_layer_surface(
                         ctx.layer_shell, ctx.surface, wl_output,
@@ -741,7 +753,18 @@ static void send_frame() {
 
         // Yay we can finally draw something!
         wl_surface_set_buffer_scale(ctx.surface, scale);
-        wl_surface_damage_buffer(ctx.surface, 0, 0, INT32_MAX, INT32_MAX);
+        if (ctx.damage) {
+                int count = cairo_region_num_rectangles(ctx.damage);
+                for (int i = 0; i < count; i++) {
+                        cairo_rectangle_int_t rect;
+                        cairo_region_get_rectangle(ctx.damage, i, &rect);
+                        wl_surface_damage_buffer(ctx.surface, rect.x, rect.y, rect.width, rect.height);
+                }
+                cairo_region_destroy(ctx.damage);
+        } else {
+                wl_surface_damage_buffer(ctx.surface, 0, 0, INT32_MAX, INT32_MAX);
+        }
+        ctx.damage = cairo_region_create();
         wl_surface_attach(ctx.surface, ctx.current_buffer->buffer, 0, 0);
         ctx.current_buffer->busy = true;
 
@@ -815,16 +838,49 @@ void wl_win_hide(window win) {
         wl_display_roundtrip(ctx.display);
 }
 
-void wl_display_surface(cairo_surface_t *srf, window winptr, const struct dimensions* dim) {
+// Add damage to a region, which is NULL if everything is damaged already
+static void damage_add(cairo_region_t **region, const cairo_region_t *damage) {
+        if (!*region)
+                return;
+
+        if (damage) {
+                cairo_region_union(*region, damage);
+        } else {
+                cairo_region_destroy(*region);
+                *region = NULL;
+        }
+}
+
+void wl_display_surface(cairo_surface_t *srf, window winptr, const struct dimensions* dim, const cairo_region_t *damage) {
         /* struct window_wl *win = (struct window_wl*)winptr; */
+        damage_add(&ctx.damage, damage);
+        damage_add(&ctx.buffer_damage[0], damage);
+        damage_add(&ctx.buffer_damage[1], damage);
+
         ctx.current_buffer = get_next_buffer(ctx.shm, ctx.buffers, dim->w, dim->h);
 
+        // The buffer still holds the image of an earlier frame, so only
+        // the areas changed since then have to be copied over
+        cairo_region_t **outdated = &ctx.buffer_damage[ctx.current_buffer - ctx.buffers];
+
         cairo_t *c = ctx.current_buffer->cairo;
         cairo_save(c);
+        cairo_set_operator(c, CAIRO_OPERATOR_SOURCE);
         cairo_set_source_surface(c, srf, 0, 0);
-        cairo_rectangle(c, 0, 0, dim->w, dim->h);
+        if (*outdated) {
+                int count = cairo_region_num_rectangles(*outdated);
+                for (int i = 0; i < count; i++) {
+                        cairo_rectangle_int_t rect;
+                        cairo_region_get_rectangle(*outdated, i, &rect);
+                        cairo_rectangle(c, rect.x, rect.y, rect.width, rect.height);
+                }
+                cairo_region_destroy(*outdated);
+        } else {
+                cairo_rectangle(c, 0, 0, dim->w, dim->h);
+        }
         cairo_fill(c);
         cairo_restore(c);
+        *outdated = cairo_region_create();
 
         ctx.cur_dim = *dim;
 
@@ -835,6 +891,8 @@ void wl_display_surface(cairo_surface_t *srf, window winptr, const struct dimens
 cairo_t* wl_win_get_context(window winptr) {
         struct window_wl *win = (struct window_wl*)winptr;
         ctx.current_buffer = get_next_buffer(ctx.shm, ctx.buffers, 500, 500);
+        // The buffer may have been created again
+        g_clear_pointer(&ctx.buffer_damage[ctx.current_buffer - ctx.buffers], cairo_region_destroy);
         win->c_surface = ctx.current_buffer->surface;
         win->c_ctx = ctx.current_buffer->cairo;
         return win->c_ctx;
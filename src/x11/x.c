@@ -45,6 +45,8 @@ struct window_x11 {
         GSource *esrc;
         int cur_screen;
         bool visible;
+        bool exposed;   //!< the content of the window got lost and has to get painted entirely
+        bool shaped;    //!< the corners got cut off by the window shape
         struct dimensions dim;
 };
 
@@ -69,9 +71,15 @@ static int x_shortcut_tear_down_error_handler(void);
 static void setopacity(Window win, unsigned long opacity);
 static void x_handle_click(XEvent ev);
 
-static void x_win_move(window winptr, int x, int y, int width, int height)
+/**
+ * Move and resize the window
+ *
+ * @returns if the position or the size of the window changed
+ */
+static bool x_win_move(window winptr, int x, int y, int width, int height)
 {
         struct window_x11 *win = (struct window_x11*)winptr;
+        bool changed = false;
 
         /* move and resize */
         if (x != win->dim.x || y != win->dim.y) {
@@ -79,6 +87,7 @@ static void x_win_move(window winptr, int x, int y, int width, int height)
 
                 win->dim.x = x;
                 win->dim.y = y;
+                changed = true;
         }
 
         if (width != win->dim.w || height != win->dim.h) {
@@ -86,7 +95,10 @@ static void x_win_move(window winptr, int x, int y, int width, int height)
 
                 win->dim.h = height;
                 win->dim.w = width;
+                changed = true;
         }
+
+        return changed;
 }
 
 static void x_win_corners_shape(struct window_x11 *win, const int rad)
@@ -158,22 +170,59 @@ static bool x_win_composited(struct window_x11 *win)
         }
 }
 
-void x_display_surface(cairo_surface_t *srf, window winptr, const struct dimensions *dim)
+/**
+ * Paint only the damaged areas of the surface into the window
+ */
+static void x_win_paint_damage(struct window_x11 *win, cairo_surface_t *srf, const cairo_region_t *damage)
+{
+        int count = cairo_region_num_rectangles(damage);
+        if (count == 0)
+                return;
+
+        cairo_save(win->c_ctx);
+        for (int i = 0; i < count; i++) {
+                cairo_rectangle_int_t rect;
+                cairo_region_get_rectangle(damage, i, &rect);
+
+                XClearArea(xctx.dpy, win->xwin, rect.x, rect.y, rect.width, rect.height, false);
+                cairo_rectangle(win->c_ctx, rect.x, rect.y, rect.width, rect.height);
+        }
+        cairo_clip(win->c_ctx);
+
+        cairo_set_source_surface(win->c_ctx, srf, 0, 0);
+        cairo_paint(win->c_ctx);
+        cairo_restore(win->c_ctx);
+        cairo_show_page(win->c_ctx);
+
+        XFlush(xctx.dpy);
+}
+
+void x_display_surface(cairo_surface_t *srf, window winptr, const struct dimensions *dim, const cairo_region_t *damage)
 {
         struct window_x11 *win = (struct window_x11*)winptr;
-        x_win_move(win, dim->x, dim->y, dim->w, dim->h);
+        bool moved = x_win_move(win, dim->x, dim->y, dim->w, dim->h);
         cairo_xlib_surface_set_size(win->root_surface, dim->w, dim->h);
 
+        /* A compositor appearing or going away changes the shape */
+        bool shaped = settings.corner_radius != 0 && !x_win_composited(win);
+
+        if (damage && !moved && !win->exposed && shaped == win->shaped) {
+                x_win_paint_damage(win, srf, damage);
+                return;
+        }
+        win->exposed = false;
+
         XClearWindow(xctx.dpy, win->xwin);
 
         cairo_set_source_surface(win->c_ctx, srf, 0, 0);
         cairo_paint(win->c_ctx);
         cairo_show_page(win->c_ctx);
 
-        if (settings.corner_radius != 0 && ! x_win_composited(win))
+        if (shaped)
                 x_win_corners_shape(win, dim->corner_radius);
         else
                 x_win_corners_unshape(win);
+        win->shaped = shaped;
 
         XFlush(xctx.dpy);
 
@@ -288,6 +337,7 @@ gboolean x_mainloop_fd_dispatch(GSource *source, GSourceFunc callback, gpointer
                 switch (ev.type) {
                 case Expose:
                         LOG_D("XEvent: processing 'Expose'");
+                        win->exposed = true;
                         if (ev.xexpose.count == 0 && win->visible) {
                                 draw();
                         }
@@ -757,7 +807,7 @@ void x_win_show(window winptr)
         XMapRaised(xctx.dpy, win->xwin);
         win->visible = true;
 
-        x_display_surface(win->root_surface, win, &win->dim);
+        x_display_surface(win->root_surface, win, &win->dim, NULL);
 }
 
 /*
@@ -777,6 +827,8 @@ void x_win_hide(window winptr)
         XUnmapWindow(xctx.dpy, win->xwin);
         XFlush(xctx.dpy);
         win->visible = false;
+        /* unmapped windows lose their content */
+        win->exposed = true;
 }
 
 /*
@@ -40,7 +40,7 @@ void x_win_destroy(window);
 void x_win_show(window);
 void x_win_hide(window);
 
-void x_display_surface(cairo_surface_t *srf, window, const struct dimensions *dim);
+void x_display_surface(cairo_surface_t *srf, window, const struct dimensions *dim, const cairo_region_t *damage);
 
 cairo_t* x_win_get_context(window);
 
@@ -335,9 +335,9 @@ TEST test_basic_notification(void)
 
 TEST test_dbus_notify_colors(void)
 {
-        const char *color_frame = "I allow all string values for frame!";
-        const char *color_bg = "I allow all string values for background!";
-        const char *color_fg = "I allow all string values for foreground!";
+        const char *color_frame = "#abc";
+        const char *color_bg = "#11223344";
+        const char *color_fg = "I am no color!";
         struct notification *n;
         struct dbus_notification *n_dbus;
 
@@ -366,9 +366,10 @@ TEST test_dbus_notify_colors(void)
 
         n = queues_debug_find_notification_by_id(id);
 
-        ASSERT_STR_EQ(n->colors.frame, color_frame);
-        ASSERT_STR_EQ(n->colors.fg, color_fg);
-        ASSERT_STR_EQ(n->colors.bg, color_bg);
+        ASSERT_EQ(0xAABBCCFF, n->colors.frame);
+        ASSERT_EQ(0x11223344, n->colors.bg);
+        ASSERT_EQm("Invalid colors have to get ignored",
+                   settings.colors_norm.fg, n->colors.fg);
 
         dbus_notification_free(n_dbus);
 
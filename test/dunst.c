@@ -24,9 +24,32 @@ TEST test_dunst_status(void)
         PASS();
 }
 
+TEST test_wake_up_coalesces(void)
+{
+        struct dunst_redraw_stats before = dunst_redraw_stats_get();
+
+        wake_up();
+        guint src = wake_up_src;
+        ASSERT(src != 0);
+
+        wake_up();
+        wake_up();
+        ASSERT_EQm("Further requests must not schedule another run", src, wake_up_src);
+
+        struct dunst_redraw_stats after = dunst_redraw_stats_get();
+        ASSERT_EQ(before.requested + 3, after.requested);
+        ASSERT_EQ(before.performed, after.performed);
+
+        g_source_remove(wake_up_src);
+        wake_up_src = 0;
+
+        PASS();
+}
+
 SUITE(suite_dunst)
 {
         RUN_TEST(test_dunst_status);
+        RUN_TEST(test_wake_up_coalesces);
 }
 
 /* vim: set tabstop=8 shiftwidth=8 expandtab textwidth=0: */
@@ -229,6 +229,608 @@ TEST test_get_pixbuf_from_icon_both_is_scaled(void)
         PASS();
 }
 
+TEST test_get_pixbuf_from_icon_large_png_is_downscaled(void)
+{
+        settings.icon_cache_size = 1024;
+        char *dir = g_dir_make_tmp("dunst-icon-XXXXXX", NULL);
+        ASSERT(dir);
+        char *path = g_build_filename(dir, "large.png", NULL);
+
+        GdkPixbuf *large = gdk_pixbuf_new(GDK_COLORSPACE_RGB, TRUE, 8, 400, 200);
+        gdk_pixbuf_fill(large, 0x20c0f080);
+        bool saved = gdk_pixbuf_save(large, path, "png", NULL, NULL);
+        g_object_unref(large);
+
+        GdkPixbuf *pixbuf = saved ? get_pixbuf_from_icon(path) : NULL;
+
+        struct icon_cache_entry *entry = NULL;
+        GHashTableIter iter;
+        g_hash_table_iter_init(&iter, icon_cache);
+        for (gpointer value; g_hash_table_iter_next(&iter, NULL, &value); )
+                if (STR_EQ(((struct icon_cache_entry *) value)->path, path))
+                        entry = value;
+        int cached_width = entry ? gdk_pixbuf_get_width(entry->pixbuf) : 0;
+        int cached_height = entry ? gdk_pixbuf_get_height(entry->pixbuf) : 0;
+
+        icon_cache_clear();
+        settings.icon_cache_size = 0;
+        unlink(path);
+        rmdir(dir);
+        g_free(path);
+        g_free(dir);
+
+        ASSERT(saved);
+        ASSERT(pixbuf);
+        ASSERT_EQ(100, gdk_pixbuf_get_width(pixbuf));
+        ASSERT_EQ(50, gdk_pixbuf_get_height(pixbuf));
+        ASSERT_EQ(100, cached_width);
+        ASSERT_EQ(50, cached_height);
+
+        /* A plain color has to survive the premultiplied box filter */
+        const guchar *px = gdk_pixbuf_read_pixels(pixbuf)
+                         + 17 * gdk_pixbuf_get_rowstride(pixbuf) + 42 * 4;
+        ASSERT_EQ(0x20, px[0]);
+        ASSERT_EQ(0xc0, px[1]);
+        ASSERT_EQ(0xf0, px[2]);
+        ASSERT_EQ(0x80, px[3]);
+
+        /* The surface got premultiplied along with the scaling */
+        cairo_surface_t *surface = icon_get_surface(pixbuf, NULL);
+        ASSERT(surface);
+        ASSERT_EQ(g_object_get_data(G_OBJECT(pixbuf), icon_pixbuf_surface_key), surface);
+        ASSERT_EQ(100, cairo_image_surface_get_width(surface));
+        const guint32 *argb = (const guint32 *)(cairo_image_surface_get_data(surface)
+                            + 17 * cairo_image_surface_get_stride(surface)) + 42;
+        ASSERT_EQ(0x80106078, *argb);
+
+        cairo_surface_destroy(surface);
+        g_object_unref(pixbuf);
+
+        PASS();
+}
+
+TEST test_pixbuf_premultiply_exact(void)
+{
+        for (int c = 0; c < 256; c++) {
+                for (int a = 0; a < 256; a++) {
+                        unsigned char exp = (unsigned char)(c * (a / (double)0xff) + .5);
+                        ASSERT_EQ_FMT(exp, premultiply(c, a), "%d");
+                }
+        }
+
+        PASS();
+}
+
+/**
+ * Convert random pixels of varying widths with every kernel the CPU
+ * supports and compare the result against the scalar kernel.
+ */
+TEST test_pixbuf_kernels_match_scalar(void)
+{
+        const int max_width = 67, height = 3;
+        const size_t stride_p = 4 * max_width + 5;
+        const size_t stride_c = 4 * max_width;
+
+        unsigned char *src = g_malloc(stride_p * height);
+        unsigned char *exp = g_malloc(stride_c * height);
+        unsigned char *got = g_malloc(stride_c * height);
+
+        srand(42);
+        for (size_t i = 0; i < stride_p * height; i++)
+                src[i] = rand() & 0xff;
+
+        const struct pixbuf_kernel *scalar = &pixbuf_kernels[G_N_ELEMENTS(pixbuf_kernels) - 1];
+        ASSERT_STR_EQ("scalar", scalar->name);
+
+        for (size_t k = 0; k < G_N_ELEMENTS(pixbuf_kernels); k++) {
+                const struct pixbuf_kernel *kernel = &pixbuf_kernels[k];
+                if (!kernel->supported())
+                        continue;
+
+                for (int width = 1; width <= max_width; width++) {
+                        for (int rgba = 0; rgba < 2; rgba++) {
+                                pixbuf_row_converter ref = rgba ? scalar->rgba : scalar->rgb;
+                                pixbuf_row_converter test = rgba ? kernel->rgba : kernel->rgb;
+
+                                memset(exp, 0, stride_c * height);
+                                memset(got, 0, stride_c * height);
+                                for (int h = 0; h < height; h++) {
+                                        ref(src + h * stride_p, exp + h * stride_c, width);
+                                        test(src + h * stride_p, got + h * stride_c, width);
+                                }
+
+                                ASSERTm(kernel->name, memcmp(exp, got, stride_c * height) == 0);
+                        }
+                }
+        }
+
+        g_free(src);
+        g_free(exp);
+        g_free(got);
+
+        PASS();
+}
+
+TEST test_icon_cache_hit(void)
+{
+        settings.icon_cache_size = 64;
+        struct icon_cache_stats before = icon_cache_stats_get();
+
+        GdkPixbuf *first = get_pixbuf_from_icon("onlysvg");
+        GdkPixbuf *second = get_pixbuf_from_icon("onlysvg");
+        ASSERT(first);
+        ASSERTm("The second lookup has to reuse the decoded icon", first == second);
+
+        struct icon_cache_stats after = icon_cache_stats_get();
+        ASSERT_EQ(before.misses + 1, after.misses);
+        ASSERT_EQ(before.hits + 1, after.hits);
+
+        g_object_unref(first);
+        g_object_unref(second);
+        icon_cache_clear();
+        settings.icon_cache_size = 0;
+
+        PASS();
+}
+
+TEST test_icon_cache_evicts_least_recently_used(void)
+{
+        /* The 16x16 SVG fills the cache on its own */
+        settings.icon_cache_size = 1;
+        struct icon_cache_stats before = icon_cache_stats_get();
+
+        GdkPixbuf *svg = get_pixbuf_from_icon("onlysvg");
+        GdkPixbuf *png = get_pixbuf_from_icon("onlypng");
+        ASSERT(svg);
+        ASSERT(png);
+        g_object_unref(svg);
+        g_object_unref(png);
+
+        svg = get_pixbuf_from_icon("onlysvg");
+        ASSERT(svg);
+        g_object_unref(svg);
+
+        struct icon_cache_stats after = icon_cache_stats_get();
+        ASSERT_EQ(before.misses + 3, after.misses);
+        ASSERT_EQ(before.hits, after.hits);
+
+        icon_cache_clear();
+        settings.icon_cache_size = 0;
+
+        PASS();
+}
+
+TEST test_pixbuf_box_kernels_match_scalar(void)
+{
+        const int max_width = 19;
+        unsigned char src[4 * 19];
+        icon_pixel exp[19], got[19];
+
+        srand(42);
+        for (size_t i = 0; i < sizeof(src); i++)
+                src[i] = rand() & 0xff;
+
+        const struct pixbuf_kernel *scalar = &pixbuf_kernels[G_N_ELEMENTS(pixbuf_kernels) - 1];
+
+        for (size_t k = 0; k < G_N_ELEMENTS(pixbuf_kernels); k++) {
+                const struct pixbuf_kernel *kernel = &pixbuf_kernels[k];
+                if (!kernel->supported())
+                        continue;
+
+                for (int width = 1; width <= max_width; width++) {
+                        for (int rgba = 0; rgba < 2; rgba++) {
+                                pixbuf_box_accumulator ref = rgba ? scalar->box_rgba : scalar->box_rgb;
+                                pixbuf_box_accumulator test = rgba ? kernel->box_rgba : kernel->box_rgb;
+
+                                for (int x = 0; x < max_width; x++)
+                                        exp[x] = got[x] = (icon_pixel) { x, 1, 2, 3 };
+                                ref(exp, src, width, 0.375f);
+                                test(got, src, width, 0.375f);
+
+                                for (int x = 0; x < max_width; x++)
+                                        for (int c = 0; c < 4; c++)
+                                                ASSERT_IN_RANGEm(kernel->name, exp[x][c], got[x][c], 0.001f);
+                        }
+                }
+        }
+
+        PASS();
+}
+
+static guint32 surface_pixel(cairo_surface_t *surface, int x, int y)
+{
+        unsigned char *data = cairo_image_surface_get_data(surface);
+        return *(guint32 *)(data + y * cairo_image_surface_get_stride(surface) + x * 4);
+}
+
+static void pixbuf_set_pixel(GdkPixbuf *pixbuf, int x, int y, const unsigned char *rgba)
+{
+        unsigned char *p = gdk_pixbuf_get_pixels(pixbuf)
+                         + y * gdk_pixbuf_get_rowstride(pixbuf)
+                         + x * gdk_pixbuf_get_n_channels(pixbuf);
+        memcpy(p, rgba, gdk_pixbuf_get_n_channels(pixbuf));
+}
+
+TEST test_icon_downscale_premultiplied_average(void)
+{
+        const unsigned char red[] = { 0xff, 0, 0, 0xff };
+        const unsigned char transparent_green[] = { 0, 0xff, 0, 0 };
+        const unsigned char blue[] = { 0, 0, 0xff, 0xff };
+
+        GdkPixbuf *pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, TRUE, 8, 4, 4);
+        for (int y = 0; y < 4; y++)
+                for (int x = 0; x < 4; x++)
+                        pixbuf_set_pixel(pixbuf, x, y, x < 2 ? (y % 2 ? transparent_green : red) : blue);
+
+        cairo_surface_t *surface = icon_downscale_to_surface(pixbuf, 2, 2);
+        ASSERT_EQ(2, cairo_image_surface_get_width(surface));
+        ASSERT_EQ(2, cairo_image_surface_get_height(surface));
+
+        /* The color of transparent pixels must not bleed into the result */
+        ASSERT_EQ_FMT(0x80800000, surface_pixel(surface, 0, 0), "%08x");
+        ASSERT_EQ_FMT(0x80800000, surface_pixel(surface, 0, 1), "%08x");
+        ASSERT_EQ_FMT(0xff0000ff, surface_pixel(surface, 1, 0), "%08x");
+        ASSERT_EQ_FMT(0xff0000ff, surface_pixel(surface, 1, 1), "%08x");
+
+        cairo_surface_destroy(surface);
+        g_object_unref(pixbuf);
+
+        PASS();
+}
+
+TEST test_icon_downscale_fractional(void)
+{
+        const unsigned char grey[][3] = { { 0, 0, 0 }, { 90, 90, 90 }, { 180, 180, 180 } };
+
+        GdkPixbuf *pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, FALSE, 8, 3, 1);
+        for (int x = 0; x < 3; x++)
+                pixbuf_set_pixel(pixbuf, x, 0, grey[x]);
+
+        /* Every target pixel covers one and a half source pixels */
+        cairo_surface_t *surface = icon_downscale_to_surface(pixbuf, 2, 1);
+        ASSERT_EQ_FMT(0xff1e1e1e, surface_pixel(surface, 0, 0), "%08x");
+        ASSERT_EQ_FMT(0xff969696, surface_pixel(surface, 1, 0), "%08x");
+
+        cairo_surface_destroy(surface);
+        g_object_unref(pixbuf);
+
+        PASS();
+}
+
+TEST test_icon_get_surface_per_size(void)
+{
+        GdkPixbuf *pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, TRUE, 8, 8, 8);
+
+        settings.max_icon_size = 4;
+        cairo_surface_t *small = icon_get_surface(pixbuf, "per-size");
+        cairo_surface_t *small_again = icon_get_surface(pixbuf, "per-size");
+        settings.max_icon_size = 6;
+        cairo_surface_t *big = icon_get_surface(pixbuf, "per-size");
+        settings.max_icon_size = 0;
+
+        ASSERT_EQ(4, cairo_image_surface_get_width(small));
+        ASSERT_EQ(6, cairo_image_surface_get_width(big));
+        ASSERT_EQm("The scaled surface has to be reused", small, small_again);
+        ASSERT(small != big);
+
+        cairo_surface_destroy(small);
+        cairo_surface_destroy(small_again);
+        cairo_surface_destroy(big);
+        g_object_unref(pixbuf);
+
+        PASS();
+}
+
+TEST bench_icon_downscale(void)
+{
+        if (!getenv("DUNST_TEST_BENCH"))
+                SKIPm("Set DUNST_TEST_BENCH=1 to run benchmarks");
+
+        enum { N_LOADS = 20 };
+        const int sizes[] = { 256, 512, 1024 };
+        const int target = 64;
+        int max_icon_size = settings.max_icon_size;
+        char *dir = g_dir_make_tmp("dunst-icon-XXXXXX", NULL);
+        ASSERT(dir);
+
+        settings.max_icon_size = target;
+
+        for (size_t i = 0; i < G_N_ELEMENTS(sizes); i++) {
+                char *path = g_build_filename(dir, "large.png", NULL);
+                GdkPixbuf *pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, TRUE, 8, sizes[i], sizes[i]);
+                unsigned char *pixels = gdk_pixbuf_get_pixels(pixbuf);
+                for (gsize p = 0; p < gdk_pixbuf_get_byte_length(pixbuf); p++)
+                        pixels[p] = p * 31;
+                gdk_pixbuf_save(pixbuf, path, "png", NULL, NULL);
+                g_object_unref(pixbuf);
+
+                /* Scaled by the loader and converted on the main loop */
+                gint64 start = g_get_monotonic_time();
+                for (int n = 0; n < N_LOADS; n++) {
+                        GdkPixbuf *scaled = gdk_pixbuf_new_from_file_at_scale(path, target, target, TRUE, NULL);
+                        cairo_surface_destroy(gdk_pixbuf_to_cairo_surface(scaled));
+                        g_object_unref(scaled);
+                }
+                double bilinear = (g_get_monotonic_time() - start) / (double) N_LOADS;
+
+                /* The worker and the main loop part of notification_icon_load() */
+                start = g_get_monotonic_time();
+                for (int n = 0; n < N_LOADS; n++) {
+                        GdkPixbuf *scaled = get_pixbuf_from_file(path);
+                        cairo_surface_destroy(icon_get_surface(scaled, NULL));
+                        g_object_unref(scaled);
+                }
+                double box = (g_get_monotonic_time() - start) / (double) N_LOADS;
+
+                printf("    %4dx%-4d -> %dx%d  loader scaling %8.0f us, box filter %8.0f us\n",
+                       sizes[i], sizes[i], target, target, bilinear, box);
+
+                unlink(path);
+                g_free(path);
+        }
+
+        settings.max_icon_size = max_icon_size;
+        rmdir(dir);
+        g_free(dir);
+
+        PASS();
+}
+
+static GVariant *icon_data_new(int width, int height, int rowstride, const unsigned char *data)
+{
+        gsize len = (height - 1) * rowstride + width * 3;
+        GVariant *pixels = g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE, data, len, 1);
+
+        return g_variant_ref_sink(g_variant_new("(iiibii@ay)", width, height, rowstride, FALSE, 8, 3, pixels));
+}
+
+TEST test_icon_get_for_data_id(void)
+{
+        /* 3x2 RGB image with three bytes of garbage after the first row */
+        unsigned char data[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 0xAA, 0xAA, 0xAA,
+                                 9, 8, 7, 6, 5, 4, 3, 2, 1 };
+        char *id, *id_garbage, *id_changed, *id_format;
+
+        GVariant *image = icon_data_new(3, 2, 12, data);
+        GdkPixbuf *pb = icon_get_for_data(image, &id);
+        ASSERT(pb);
+        g_object_unref(pb);
+        g_variant_unref(image);
+
+        data[10] = 0x55;
+        image = icon_data_new(3, 2, 12, data);
+        pb = icon_get_for_data(image, &id_garbage);
+        ASSERT(pb);
+        g_object_unref(pb);
+        g_variant_unref(image);
+        ASSERT_STR_EQm("The spacer at the row end must not change the id", id, id_garbage);
+
+        data[20] = 2;
+        image = icon_data_new(3, 2, 12, data);
+        pb = icon_get_for_data(image, &id_changed);
+        ASSERT(pb);
+        g_object_unref(pb);
+        g_variant_unref(image);
+        ASSERTm("Different pixels must change the id", !STR_EQ(id, id_changed));
+
+        /* The same bytes, but as a 1x7 image */
+        image = icon_data_new(1, 7, 3, data);
+        pb = icon_get_for_data(image, &id_format);
+        ASSERT(pb);
+        g_object_unref(pb);
+        g_variant_unref(image);
+        ASSERTm("A different image format must change the id", !STR_EQ(id_changed, id_format));
+
+        g_free(id);
+        g_free(id_garbage);
+        g_free(id_changed);
+        g_free(id_format);
+
+        PASS();
+}
+
+TEST test_icon_get_for_data_shared(void)
+{
+        settings.icon_cache_size = 64;
+
+        unsigned char data[4 * 4 * 3];
+        for (int i = 0; i < sizeof(data); i++)
+                data[i] = i * 7;
+
+        char *id1, *id2;
+        GVariant *image1 = icon_data_new(4, 4, 12, data);
+        GVariant *image2 = icon_data_new(4, 4, 12, data);
+
+        GdkPixbuf *pb1 = icon_get_for_data(image1, &id1);
+        GdkPixbuf *pb2 = icon_get_for_data(image2, &id2);
+        ASSERT(pb1);
+        ASSERT_STR_EQ(id1, id2);
+        ASSERTm("Identical images have to share the pixbuf", pb1 == pb2);
+
+        GVariant *pixels = g_variant_get_child_value(image1, 6);
+        ASSERTm("The cached pixbuf must not keep the message alive",
+                gdk_pixbuf_read_pixels(pb1) != g_variant_get_data(pixels));
+        g_variant_unref(pixels);
+
+        g_object_unref(pb1);
+        g_object_unref(pb2);
+        g_variant_unref(image1);
+        g_variant_unref(image2);
+        g_free(id1);
+        g_free(id2);
+        icon_cache_clear();
+        settings.icon_cache_size = 0;
+
+        PASS();
+}
+
+struct icon_loaded_result {
+        int calls;
+        int destroyed;
+        GdkPixbuf *pixbuf;
+        char *id;
+};
+
+static void icon_loaded(GdkPixbuf *pixbuf, const char *id, gpointer data)
+{
+        struct icon_loaded_result *result = data;
+
+        result->calls++;
+        if (result->pixbuf)
+                g_object_unref(result->pixbuf);
+        result->pixbuf = pixbuf ? g_object_ref(pixbuf) : NULL;
+        g_free(result->id);
+        result->id = g_strdup(id);
+}
+
+static void icon_loaded_destroy(gpointer data)
+{
+        struct icon_loaded_result *result = data;
+        result->destroyed++;
+}
+
+TEST test_icon_get_for_name_async(void)
+{
+        settings.icon_cache_size = 64;
+        icon_loader_init();
+
+        struct icon_loaded_result result = { 0 };
+        char *id1 = NULL, *id2 = NULL, *id3 = NULL;
+
+        GdkPixbuf *pb = icon_get_for_name_async("onlysvg", &id1, icon_loaded, &result, icon_loaded_destroy);
+        ASSERTm("The icon must not get decoded on the calling thread", !pb);
+        ASSERT_STR_EQ("onlysvg", id1);
+
+        pb = icon_get_for_name_async("onlysvg", &id2, icon_loaded, &result, icon_loaded_destroy);
+        ASSERT(!pb);
+        ASSERT_STR_EQ("onlysvg", id2);
+        ASSERT_EQm("Requests for the same icon have to share the decode",
+                   1, g_hash_table_size(icon_loads));
+
+        gint64 timeout = g_get_monotonic_time() + 2 * G_USEC_PER_SEC;
+        while (result.calls < 2 && g_get_monotonic_time() < timeout) {
+                if (!g_main_context_iteration(NULL, FALSE))
+                        g_usleep(1000);
+        }
+        ASSERT_EQ(2, result.calls);
+        ASSERT_EQ(2, result.destroyed);
+        ASSERT(result.pixbuf);
+        ASSERT(IS_ICON_SVG(result.pixbuf));
+        ASSERT_STR_EQ("onlysvg", result.id);
+
+        /* Decoded icons are served from the cache without a callback */
+        pb = icon_get_for_name_async("onlysvg", &id3, icon_loaded, &result, icon_loaded_destroy);
+        ASSERT_EQ(result.pixbuf, pb);
+        ASSERT_STR_EQ("onlysvg", id3);
+        ASSERT_EQ(2, result.calls);
+        ASSERT_EQ(3, result.destroyed);
+
+        g_object_unref(pb);
+        g_clear_object(&result.pixbuf);
+        g_free(result.id);
+        g_free(id1);
+        g_free(id2);
+        g_free(id3);
+        icon_teardown();
+        settings.icon_cache_size = 0;
+
+        PASS();
+}
+
+TEST test_icon_get_for_name_async_teardown(void)
+{
+        icon_loader_init();
+
+        struct icon_loaded_result result = { 0 };
+        char *id = NULL;
+
+        ASSERT(!icon_get_for_name_async("onlypng", &id, icon_loaded, &result, icon_loaded_destroy));
+        icon_teardown();
+
+        /* Pending loads get dropped without calling back */
+        while (g_main_context_iteration(NULL, FALSE));
+        ASSERT_EQ(0, result.calls);
+        ASSERT_EQ(1, result.destroyed);
+
+        g_free(id);
+
+        PASS();
+}
+
+TEST test_get_path_from_icon_index_refresh(void)
+{
+        char *icon_path = settings.icon_path;
+        char *folder = g_dir_make_tmp("dunst-icons-XXXXXX", NULL);
+        ASSERT(folder);
+
+        char *png = g_build_filename(folder, "fresh.png", NULL);
+        char *svg = g_build_filename(folder, "fresh.svg", NULL);
+        settings.icon_path = folder;
+
+        bool created = g_file_set_contents(png, "", 0, NULL);
+        char *first = get_path_from_icon_name("fresh");
+
+        /* The preferred suffix has to win, once the monitor reported it */
+        created = created && g_file_set_contents(svg, "", 0, NULL);
+        icon_path_index_changed(NULL, NULL, NULL, G_FILE_MONITOR_EVENT_CREATED, NULL);
+        char *added = get_path_from_icon_name("fresh");
+
+        /* Removed files must not be returned from the index */
+        unlink(svg);
+        char *removed = get_path_from_icon_name("fresh");
+
+        unlink(png);
+        rmdir(folder);
+        settings.icon_path = icon_path;
+
+        ASSERT(created);
+        ASSERT_STR_EQ(png, first);
+        ASSERT_STR_EQ(svg, added);
+        ASSERT_STR_EQ(png, removed);
+
+        g_free(first);
+        g_free(added);
+        g_free(removed);
+        g_free(png);
+        g_free(svg);
+        g_free(folder);
+
+        PASS();
+}
+
+TEST test_get_path_from_icon_index_monitor(void)
+{
+        char *icon_path = settings.icon_path;
+        char *folder = g_dir_make_tmp("dunst-icons-XXXXXX", NULL);
+        ASSERT(folder);
+
+        char *png = g_build_filename(folder, "fresh.png", NULL);
+        settings.icon_path = folder;
+
+        /* Build the index and with it the monitor of the folder */
+        g_free(get_path_from_icon_name("fresh"));
+        bool created = g_file_set_contents(png, "", 0, NULL);
+
+        gint64 timeout = g_get_monotonic_time() + G_USEC_PER_SEC;
+        while (created && !icon_path_index_dirty && g_get_monotonic_time() < timeout) {
+                if (!g_main_context_iteration(NULL, FALSE))
+                        g_usleep(1000);
+        }
+        bool noticed = icon_path_index_dirty;
+
+        unlink(png);
+        rmdir(folder);
+        settings.icon_path = icon_path;
+        g_free(png);
+        g_free(folder);
+
+        ASSERT(created);
+        if (!noticed)
+                SKIPm("The file monitor didn't report the new file in time");
+
+        PASS();
+}
+
 SUITE(suite_icon)
 {
         // set only valid icons in the path
@@ -247,6 +849,8 @@ SUITE(suite_icon)
 
         RUN_TEST(test_get_path_from_icon_null);
         RUN_TEST(test_get_path_from_icon_sorting);
+        RUN_TEST(test_get_path_from_icon_index_refresh);
+        RUN_TEST(test_get_path_from_icon_index_monitor);
         RUN_TEST(test_get_path_from_icon_name_full);
         RUN_TEST(test_get_pixbuf_from_file_tilde);
         RUN_TEST(test_get_pixbuf_from_file_absolute);
@@ -257,11 +861,25 @@ SUITE(suite_icon)
         RUN_TEST(test_get_pixbuf_from_icon_filename);
         RUN_TEST(test_get_pixbuf_from_icon_fileuri);
         RUN_TEST(test_icon_size_clamp_not_necessary);
+        RUN_TEST(test_pixbuf_premultiply_exact);
+        RUN_TEST(test_pixbuf_kernels_match_scalar);
+        RUN_TEST(test_icon_get_for_data_id);
+        RUN_TEST(test_icon_get_for_data_shared);
+        RUN_TEST(test_pixbuf_box_kernels_match_scalar);
+        RUN_TEST(test_icon_downscale_premultiplied_average);
+        RUN_TEST(test_icon_downscale_fractional);
+        RUN_TEST(test_icon_get_surface_per_size);
+        RUN_TEST(bench_icon_downscale);
 
         settings.min_icon_size = 16;
         settings.max_icon_size = 100;
 
         RUN_TEST(test_get_pixbuf_from_icon_both_is_scaled);
+        RUN_TEST(test_get_pixbuf_from_icon_large_png_is_downscaled);
+        RUN_TEST(test_icon_cache_hit);
+        RUN_TEST(test_icon_cache_evicts_least_recently_used);
+        RUN_TEST(test_icon_get_for_name_async);
+        RUN_TEST(test_icon_get_for_name_async_teardown);
         RUN_TEST(test_icon_size_clamp_too_small);
         RUN_TEST(test_icon_size_clamp_not_necessary);
         RUN_TEST(test_icon_size_clamp_too_big);
@@ -0,0 +1,362 @@
+#include "../src/icon_theme.c"
+#include "greatest.h"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <utime.h>
+
+#include "../src/icon.h"
+
+/** An image of an icon in a generated icon theme */
+struct test_image {
+        const char *name;
+        int dir;                /**< Index of the directory in the theme */
+        guint16 flags;          /**< CACHE_HAS_SUFFIX_* */
+};
+
+static char *basedir = NULL;
+
+static void append16(GString *s, guint16 v)
+{
+        v = GUINT16_TO_BE(v);
+        g_string_append_len(s, (const char *)&v, sizeof(v));
+}
+
+static void append32(GString *s, guint32 v)
+{
+        v = GUINT32_TO_BE(v);
+        g_string_append_len(s, (const char *)&v, sizeof(v));
+}
+
+static void set32(GString *s, gsize offset, guint32 v)
+{
+        v = GUINT32_TO_BE(v);
+        memcpy(s->str + offset, &v, sizeof(v));
+}
+
+/**
+ * Write an icon-theme.cache like gtk-update-icon-cache does.
+ *
+ * All images of the same icon have to follow each other.
+ */
+static void write_cache(const char *path,
+                        const char **dirs,
+                        const struct test_image *images,
+                        size_t n_images)
+{
+        GString *s = g_string_new(NULL);
+        size_t n_dirs = g_strv_length((char **)dirs);
+        const guint32 n_buckets = 31;
+        guint32 buckets[31];
+        GArray *names = g_array_new(FALSE, FALSE, sizeof(gsize));
+
+        for (size_t i = 0; i < n_buckets; i++)
+                buckets[i] = CACHE_NONE;
+
+        append16(s, 1);
+        append16(s, 0);
+        append32(s, 0);
+        append32(s, 0);
+
+        set32(s, 8, s->len);
+        append32(s, n_dirs);
+        gsize dir_slots = s->len;
+        for (size_t i = 0; i < n_dirs; i++)
+                append32(s, 0);
+
+        set32(s, 4, s->len);
+        append32(s, n_buckets);
+        gsize bucket_slots = s->len;
+        for (size_t i = 0; i < n_buckets; i++)
+                append32(s, CACHE_NONE);
+
+        for (size_t i = 0; i < n_images; ) {
+                size_t n = 1;
+                while (i + n < n_images && STR_EQ(images[i].name, images[i + n].name))
+                        n++;
+
+                guint32 bucket = icon_name_hash(images[i].name) % n_buckets;
+                gsize name_slot = s->len + 4;
+
+                append32(s, buckets[bucket]);
+                buckets[bucket] = s->len - 4;
+                append32(s, 0);
+                append32(s, s->len + 4);
+                g_array_append_val(names, name_slot);
+
+                append32(s, n);
+                for (size_t j = i; j < i + n; j++) {
+                        append16(s, images[j].dir);
+                        append16(s, images[j].flags);
+                        append32(s, CACHE_NONE);
+                }
+
+                i += n;
+        }
+
+        for (size_t i = 0; i < n_buckets; i++)
+                set32(s, bucket_slots + 4 * i, buckets[i]);
+
+        for (size_t i = 0; i < n_dirs; i++) {
+                set32(s, dir_slots + 4 * i, s->len);
+                g_string_append_len(s, dirs[i], strlen(dirs[i]) + 1);
+        }
+
+        for (size_t i = 0, icon = 0; i < n_images; i++) {
+                if (i > 0 && STR_EQ(images[i].name, images[i - 1].name))
+                        continue;
+                set32(s, g_array_index(names, gsize, icon++), s->len);
+                g_string_append_len(s, images[i].name, strlen(images[i].name) + 1);
+        }
+
+        g_file_set_contents(path, s->str, s->len, NULL);
+        g_array_free(names, TRUE);
+        g_string_free(s, TRUE);
+}
+
+/**
+ * Create an icon theme with empty icon files and its cache in #basedir.
+ */
+static void create_theme(const char *name,
+                         const char *index,
+                         const char **dirs,
+                         const struct test_image *images,
+                         size_t n_images)
+{
+        char *path = g_build_filename(basedir, name, NULL);
+        char *index_path = g_build_filename(path, "index.theme", NULL);
+
+        for (const char **dir = dirs; *dir; dir++) {
+                char *dir_path = g_build_filename(path, *dir, NULL);
+                g_mkdir_with_parents(dir_path, 0700);
+                g_free(dir_path);
+        }
+        g_file_set_contents(index_path, index, -1, NULL);
+
+        for (size_t i = 0; i < n_images; i++) {
+                const char *suffix = images[i].flags & CACHE_HAS_SUFFIX_SVG ? ".svg" : ".png";
+                char *filename = g_strconcat(images[i].name, suffix, NULL);
+                char *file = g_build_filename(path, dirs[images[i].dir], filename, NULL);
+                g_file_set_contents(file, "", 0, NULL);
+                g_free(file);
+                g_free(filename);
+        }
+
+        char *cache_path = g_build_filename(path, "icon-theme.cache", NULL);
+        write_cache(cache_path, dirs, images, n_images);
+
+        g_free(cache_path);
+        g_free(index_path);
+        g_free(path);
+}
+
+static void remove_tree(const char *path)
+{
+        GDir *dir = g_dir_open(path, 0, NULL);
+
+        if (dir) {
+                const char *name;
+                while ((name = g_dir_read_name(dir))) {
+                        char *child = g_build_filename(path, name, NULL);
+                        remove_tree(child);
+                        g_free(child);
+                }
+                g_dir_close(dir);
+                rmdir(path);
+        } else {
+                unlink(path);
+        }
+}
+
+static void load_test_theme(void)
+{
+        char *basedirs[] = { basedir, NULL };
+        icon_theme_load("test-theme", basedirs);
+}
+
+TEST test_icon_theme_lookup_size(const char *name, int min_size, int max_size, const char *expected)
+{
+        char *result = icon_theme_lookup(name, min_size, max_size);
+
+        if (expected) {
+                char *path = g_build_filename(basedir, expected, NULL);
+                ASSERT_STR_EQ(path, result);
+                g_free(path);
+        } else {
+                ASSERT_EQ(NULL, result);
+        }
+
+        g_free(result);
+        PASS();
+}
+
+TEST test_icon_theme_disabled(void)
+{
+        char *icon_theme = settings.icon_theme;
+        settings.icon_theme = "";
+
+        ASSERT_EQ(NULL, icon_theme_lookup("sized", 0, 0));
+
+        settings.icon_theme = icon_theme;
+        PASS();
+}
+
+TEST test_icon_theme_outdated_cache(void)
+{
+        char *path = g_build_filename(basedir, "test-parent", NULL);
+        struct utimbuf future = { time(NULL) + 100, time(NULL) + 100 };
+        ASSERT_EQ(0, utime(path, &future));
+
+        load_test_theme();
+        char *result = icon_theme_lookup("inherited", 0, 0);
+        ASSERT_EQm("An outdated cache must not be used", NULL, result);
+
+        struct utimbuf past = { time(NULL) - 100, time(NULL) - 100 };
+        utime(path, &past);
+        load_test_theme();
+        g_free(path);
+
+        PASS();
+}
+
+/**
+ * Compare the lookup in an icon theme with the lookup in the icon_path
+ * for a theme with many directories. Only runs if DUNST_TEST_BENCH is set.
+ */
+TEST bench_icon_theme_lookup(void)
+{
+        if (!getenv("DUNST_TEST_BENCH"))
+                SKIPm("Set DUNST_TEST_BENCH=1 to run benchmarks");
+
+        enum { N_DIRS = 24, N_ICONS = 100, N_LOOKUPS = 20000 };
+        char *dirs[N_DIRS + 1] = { NULL };
+        char *names[N_ICONS];
+        struct test_image images[N_ICONS];
+        GString *index = g_string_new("[Icon Theme]\nDirectories=");
+        char *folders[N_DIRS + 1] = { NULL };
+
+        for (int d = 0; d < N_DIRS; d++) {
+                dirs[d] = g_strdup_printf("%dx%d/apps", 8 + 4 * d, 8 + 4 * d);
+                g_string_append_printf(index, "%s%s", d ? "," : "", dirs[d]);
+                folders[d] = g_build_filename(basedir, "bench-theme", dirs[d], NULL);
+        }
+        g_string_append(index, "\n");
+        for (int d = 0; d < N_DIRS; d++)
+                g_string_append_printf(index, "[%s]\nSize=%d\nType=Fixed\n", dirs[d], 8 + 4 * d);
+
+        /* All icons are in the last directory, which is the worst case
+         * for searching the icon_path */
+        for (int i = 0; i < N_ICONS; i++) {
+                names[i] = g_strdup_printf("bench-icon-%d", i);
+                images[i] = (struct test_image){ names[i], N_DIRS - 1, CACHE_HAS_SUFFIX_PNG };
+        }
+        create_theme("bench-theme", index->str, (const char **)dirs, images, N_ICONS);
+
+        char *basedirs[] = { basedir, NULL };
+        char *icon_theme = settings.icon_theme;
+        char *icon_path = settings.icon_path;
+        settings.icon_theme = "bench-theme";
+        settings.icon_path = g_strjoinv(":", folders);
+        icon_theme_load(settings.icon_theme, basedirs);
+
+        struct {
+                const char *what;
+                const char *prefix;
+                bool theme;
+        } runs[] = {
+                { "icon theme, found",   "bench-icon-", true },
+                { "icon_path, found",    "bench-icon-", false },
+                { "icon theme, missing", "missing-",    true },
+                { "icon_path, missing",  "missing-",    false },
+        };
+
+        for (size_t r = 0; r < G_N_ELEMENTS(runs); r++) {
+                /* Keep get_path_from_icon_name() from asking the theme */
+                settings.icon_theme = runs[r].theme ? "bench-theme" : "";
+                gint64 start = g_get_monotonic_time();
+
+                for (int i = 0; i < N_LOOKUPS; i++) {
+                        char name[32];
+                        snprintf(name, sizeof(name), "%s%d", runs[r].prefix, i % N_ICONS);
+                        char *path = runs[r].theme ? icon_theme_lookup(name, 0, 0)
+                                                   : get_path_from_icon_name(name);
+                        g_free(path);
+                }
+
+                double ns = (g_get_monotonic_time() - start) * 1000.0 / N_LOOKUPS;
+                printf("    %-24s %10.0f ns/lookup\n", runs[r].what, ns);
+        }
+
+        g_free(settings.icon_path);
+        settings.icon_path = icon_path;
+        settings.icon_theme = icon_theme;
+        load_test_theme();
+
+        for (int i = 0; i < N_ICONS; i++)
+                g_free(names[i]);
+        for (int d = 0; d < N_DIRS; d++) {
+                g_free(dirs[d]);
+                g_free(folders[d]);
+        }
+        g_string_free(index, TRUE);
+
+        PASS();
+}
+
+SUITE(suite_icon_theme)
+{
+        basedir = g_dir_make_tmp("dunst-themes-XXXXXX", NULL);
+
+        const char *dirs[] = { "16x16/apps", "32x32/apps", "scalable/apps", "64x64@2/apps", NULL };
+        const struct test_image images[] = {
+                { "fixed", 0, CACHE_HAS_SUFFIX_PNG },
+                { "hidpi", 3, CACHE_HAS_SUFFIX_PNG },
+                { "sized", 0, CACHE_HAS_SUFFIX_PNG },
+                { "sized", 1, CACHE_HAS_SUFFIX_PNG },
+                { "sized", 2, CACHE_HAS_SUFFIX_SVG },
+        };
+        create_theme("test-theme",
+                     "[Icon Theme]\n"
+                     "Name=Test\n"
+                     "Inherits=test-parent\n"
+                     "Directories=16x16/apps,32x32/apps,scalable/apps,64x64@2/apps\n"
+                     "[16x16/apps]\nSize=16\nType=Fixed\n"
+                     "[32x32/apps]\nSize=32\nType=Threshold\n"
+                     "[scalable/apps]\nSize=48\nType=Scalable\nMinSize=8\nMaxSize=512\n"
+                     "[64x64@2/apps]\nSize=64\nScale=2\n",
+                     dirs, images, G_N_ELEMENTS(images));
+
+        const char *parent_dirs[] = { "24x24/apps", NULL };
+        const struct test_image parent_images[] = {
+                { "inherited", 0, CACHE_HAS_SUFFIX_PNG },
+                { "sized", 0, CACHE_HAS_SUFFIX_PNG },
+        };
+        create_theme("test-parent",
+                     "[Icon Theme]\n"
+                     "Name=Parent\n"
+                     "Directories=24x24/apps\n"
+                     "[24x24/apps]\nSize=24\nType=Fixed\n",
+                     parent_dirs, parent_images, G_N_ELEMENTS(parent_images));
+
+        char *icon_theme = settings.icon_theme;
+        settings.icon_theme = "test-theme";
+        load_test_theme();
+
+        RUN_TESTp(test_icon_theme_lookup_size, "sized", 32, 32, "test-theme/32x32/apps/sized.png");
+        RUN_TESTp(test_icon_theme_lookup_size, "sized", 0, 0, "test-theme/32x32/apps/sized.png");
+        RUN_TESTp(test_icon_theme_lookup_size, "sized", 0, 16, "test-theme/16x16/apps/sized.png");
+        RUN_TESTp(test_icon_theme_lookup_size, "sized", 0, 100, "test-theme/scalable/apps/sized.svg");
+        RUN_TESTp(test_icon_theme_lookup_size, "fixed", 0, 64, "test-theme/16x16/apps/fixed.png");
+        RUN_TESTp(test_icon_theme_lookup_size, "inherited", 0, 0, "test-parent/24x24/apps/inherited.png");
+        RUN_TESTp(test_icon_theme_lookup_size, "hidpi", 0, 0, NULL);
+        RUN_TESTp(test_icon_theme_lookup_size, "missing", 0, 0, NULL);
+        RUN_TEST(test_icon_theme_disabled);
+        RUN_TEST(test_icon_theme_outdated_cache);
+        RUN_TEST(bench_icon_theme_lookup);
+
+        settings.icon_theme = icon_theme;
+        icon_theme_teardown();
+        remove_tree(basedir);
+        g_clear_pointer(&basedir, g_free);
+}
+/* vim: set tabstop=8 shiftwidth=8 expandtab textwidth=0: */
@@ -1,6 +1,8 @@
 #include "../src/markup.c"
 #include "greatest.h"
 
+#include <stdlib.h>
+
 TEST test_markup_strip(void)
 {
         char *ptr;
@@ -17,6 +19,12 @@ TEST test_markup_strip(void)
         g_free(ptr);
         ASSERT_STR_EQ(">A  ", (ptr=markup_strip(g_strdup(">A <img> <string"))));
         g_free(ptr);
+        ASSERT_STR_EQ("&'", (ptr=markup_strip(g_strdup("&&apos;"))));
+        g_free(ptr);
+        ASSERT_STR_EQ("<", (ptr=markup_strip(g_strdup("&l<b>t;"))));
+        g_free(ptr);
+        ASSERT_STR_EQ("&am", (ptr=markup_strip(g_strdup("&am"))));
+        g_free(ptr);
 
         PASS();
 }
@@ -61,6 +69,14 @@ TEST test_markup_transform(void)
         free(ptr);
         ASSERT_STR_EQ("&amp;; &amp;#; &amp;#x;", (ptr=markup_transform(g_strdup("&; &#; &#x;"), MARKUP_FULL)));
         free(ptr);
+        ASSERT_STR_EQ("&amp;&amp; &#12; &amp;#12", (ptr=markup_transform(g_strdup("&&amp; &#12; &#12"), MARKUP_FULL)));
+        free(ptr);
+
+        // Entities and linebreaks split by tags
+        ASSERT_STR_EQ("&lt; a b", (ptr=markup_transform(g_strdup("&l<i>t; a<br/>b"), MARKUP_STRIP)));
+        free(ptr);
+        ASSERT_STR_EQ("a&amp;&quot;b", (ptr=markup_transform(g_strdup("a<b x=\"<br>\">&amp;</b>&quot;b"), MARKUP_STRIP)));
+        free(ptr);
 
         PASS();
 }
@@ -149,12 +165,44 @@ TEST test_markup_strip_img(void)
         PASS();
 }
 
+TEST bench_markup_transform(void)
+{
+        if (!getenv("DUNST_TEST_BENCH"))
+                SKIPm("Set DUNST_TEST_BENCH=1 to run benchmarks");
+
+        enum { N_RUNS = 200 };
+        const char *line = "<b>alice</b>: did you see <a href=\"https://example.com/?a=1&amp;b=2\">this</a>? "
+                           "it's \"great\" &amp; fast &lt;3 &#128512;<br/>";
+        const char *modes[] = { [MARKUP_NO] = "no", [MARKUP_STRIP] = "strip", [MARKUP_FULL] = "full" };
+        int ignore_newline = settings.ignore_newline;
+
+        GString *body = g_string_new(NULL);
+        while (body->len < 64 * 1024)
+                g_string_append(body, line);
+
+        settings.ignore_newline = true;
+        for (enum markup_mode mode = MARKUP_NO; mode <= MARKUP_FULL; mode++) {
+                gint64 start = g_get_monotonic_time();
+                for (int n = 0; n < N_RUNS; n++)
+                        g_free(markup_transform(g_strdup(body->str), mode));
+                double us = (g_get_monotonic_time() - start) / (double) N_RUNS;
+
+                printf("    %-5s %zu KiB body: %8.1f us, %7.1f MiB/s\n",
+                       modes[mode], body->len / 1024, us, body->len / us / 1.048576);
+        }
+        settings.ignore_newline = ignore_newline;
+
+        g_string_free(body, TRUE);
+        PASS();
+}
+
 SUITE(suite_markup)
 {
         RUN_TEST(test_markup_strip);
         RUN_TEST(test_markup_strip_a);
         RUN_TEST(test_markup_strip_img);
         RUN_TEST(test_markup_transform);
+        RUN_TEST(bench_markup_transform);
 }
 
 /* vim: set tabstop=8 shiftwidth=8 expandtab textwidth=0: */
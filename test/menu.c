@@ -3,6 +3,52 @@
 #include "greatest.h"
 
 #include <glib.h>
+#include <locale.h>
+#include <regex.h>
+#include <stdlib.h>
+
+/* Bodies of notifications as sent by common applications */
+static const char *notification_bodies[] = {
+        "alice: did you see https://github.com/dunst-project/dunst/pull/830? Looks good to me",
+        "New comment on your post: \"Check out www.example.org/blog/2020/06/post-title.html, it explains (mostly) everything.\"",
+        "Build #1234 of project/master failed. See https://ci.example.com/job/project/1234/console (started by bob)",
+        "Your download of ubuntu-20.04-desktop-amd64.iso is complete",
+        "Meeting in 5 minutes: Weekly sync https://meet.example.com/abc-defg-hij?authuser=0&hs=122",
+        "From: Carol <carol@example.com>\nSubject: Re: the plan\nSee https://en.wikipedia.org/wiki/Plan_(disambiguation) for details.",
+        "Battery low (5%). Please connect your charger.",
+        "mailto:support@example.com wrote: ticket #4711 was updated, visit HTTPS://Support.Example.com/t/4711.",
+        "Spotify: Now playing \"Song Title\" by Artist",
+        "[#dunst] dave: ftp://ftp.example.com/pub/file.tar.gz and file:///home/dave/notes.txt, thanks!",
+        "You have 3 new messages",
+        "Check the docs at https://docs.example.com/api/v2/users/{id}/settings#permissions, or ask in chat.",
+};
+
+/* The regular expression extract_urls() used before the scanner */
+static char *test_extract_urls_regex(regex_t *regex, const char *to_match)
+{
+        GString *urls = NULL;
+        const char *p = to_match;
+        regmatch_t m;
+
+        while (!regexec(regex, p, 1, &m, 0) && m.rm_so != -1) {
+                if (!urls)
+                        urls = g_string_new(NULL);
+                else
+                        g_string_append_c(urls, '\n');
+                g_string_append_len(urls, p + m.rm_so, m.rm_eo - m.rm_so);
+                p += m.rm_eo;
+        }
+        return urls ? g_string_free(urls, FALSE) : NULL;
+}
+
+static void test_url_regex_init(regex_t *regex)
+{
+        regcomp(regex,
+                "\\<(https?://|ftps?://|news://|mailto:|file://|www\\.)"
+                "[-[:alnum:]_\\@;/?:&=%$.+!*\x27,~#]*"
+                "(\\([-[:alnum:]_\\@;/?:&=%$.+!*\x27,~#]*\\)|[-[:alnum:]_\\@;/?:&=%$+*~])+",
+                REG_EXTENDED | REG_ICASE);
+}
 
 TEST test_extract_urls_from_empty_string(void)
 {
@@ -61,6 +107,145 @@ TEST test_extract_urls_from_one_url_anchor(void)
         PASS();
 }
 
+TEST test_extract_urls_parentheses(void)
+{
+        char *urls = extract_urls("See (https://en.wikipedia.org/wiki/Dunst_(software)), it's nice");
+        ASSERT_STR_EQ("https://en.wikipedia.org/wiki/Dunst_(software)", urls);
+        g_free(urls);
+
+        urls = extract_urls("https://example.com/(a)/b.html");
+        ASSERT_STR_EQm("Only final characters may follow parentheses", "https://example.com/(a)/b", urls);
+        g_free(urls);
+
+        urls = extract_urls("https://example.com/(unclosed");
+        ASSERT_STR_EQ("https://example.com/", urls);
+        g_free(urls);
+        PASS();
+}
+
+TEST test_extract_urls_word_start(void)
+{
+        char *urls = extract_urls("nohttp://example.com but WWW.example.com.");
+        ASSERT_STR_EQ("WWW.example.com", urls);
+        g_free(urls);
+
+        char *saved_locale = g_strdup(setlocale(LC_CTYPE, NULL));
+
+        /* Letters are alphanumeric in the locale only */
+        if (setlocale(LC_CTYPE, "C.UTF-8")) {
+                urls = extract_urls("https://de.wikipedia.org/wiki/Müller’s");
+                ASSERT_STR_EQ("https://de.wikipedia.org/wiki/Müller", urls);
+                g_free(urls);
+        }
+
+        setlocale(LC_CTYPE, "C");
+        urls = extract_urls("https://de.wikipedia.org/wiki/Müller’s");
+        ASSERT_STR_EQ("https://de.wikipedia.org/wiki/M", urls);
+        g_free(urls);
+
+        setlocale(LC_CTYPE, saved_locale);
+        g_free(saved_locale);
+        PASS();
+}
+
+TEST test_extract_urls_matches_regex(void)
+{
+        const char *bodies[G_N_ELEMENTS(notification_bodies) + 3];
+        for (int i = 0; i < G_N_ELEMENTS(notification_bodies); i++)
+                bodies[i] = notification_bodies[i];
+        bodies[G_N_ELEMENTS(notification_bodies)] = "Ärger mit https://de.wikipedia.org/wiki/Straße_(Begriffsklärung)… und www.ß.de";
+        bodies[G_N_ELEMENTS(notification_bodies) + 1] = "日本語https://例え.jp/パス(括弧)。file://ω";
+        bodies[G_N_ELEMENTS(notification_bodies) + 2] = "invalid https://example.com/\xff\xfe and http://x\xc3";
+
+        const char *locales[] = { "C", "C.UTF-8" };
+        char *saved_locale = g_strdup(setlocale(LC_CTYPE, NULL));
+
+        for (int l = 0; l < G_N_ELEMENTS(locales); l++) {
+                if (!setlocale(LC_CTYPE, locales[l]))
+                        continue;
+
+                regex_t regex;
+                test_url_regex_init(&regex);
+
+                for (int i = 0; i < G_N_ELEMENTS(bodies); i++) {
+                        char *expected = test_extract_urls_regex(&regex, bodies[i]);
+                        char *urls = extract_urls(bodies[i]);
+
+                        ASSERT_STR_EQm(bodies[i], expected ? expected : "(none)", urls ? urls : "(none)");
+
+                        g_free(expected);
+                        g_free(urls);
+                }
+
+                regfree(&regex);
+        }
+
+        setlocale(LC_CTYPE, saved_locale);
+        g_free(saved_locale);
+        PASS();
+}
+
+TEST bench_extract_urls(void)
+{
+        if (!getenv("DUNST_TEST_BENCH"))
+                SKIPm("Set DUNST_TEST_BENCH=1 to run benchmarks");
+
+        enum { N_RUNS = 2000 };
+        /* regexec behaves differently in multibyte locales, which dunst
+         * runs with, so compare in both */
+        const char *locales[] = { "C", "C.UTF-8" };
+        char *saved_locale = g_strdup(setlocale(LC_CTYPE, NULL));
+
+        GString *body = g_string_new(NULL);
+        for (int i = 0; i < G_N_ELEMENTS(notification_bodies); i++)
+                g_string_append_printf(body, "%s ", notification_bodies[i]);
+        while (body->len < 64 * 1024)
+                g_string_append(body, body->str);
+
+        for (int l = 0; l < G_N_ELEMENTS(locales); l++) {
+                if (!setlocale(LC_CTYPE, locales[l]))
+                        continue;
+
+                regex_t regex;
+                test_url_regex_init(&regex);
+
+                gint64 start = g_get_monotonic_time();
+                for (int n = 0; n < N_RUNS; n++)
+                        for (int i = 0; i < G_N_ELEMENTS(notification_bodies); i++)
+                                g_free(test_extract_urls_regex(&regex, notification_bodies[i]));
+                double regex_us = (g_get_monotonic_time() - start) / (double) N_RUNS;
+
+                start = g_get_monotonic_time();
+                for (int n = 0; n < N_RUNS; n++)
+                        for (int i = 0; i < G_N_ELEMENTS(notification_bodies); i++)
+                                g_free(extract_urls(notification_bodies[i]));
+                double scanner_us = (g_get_monotonic_time() - start) / (double) N_RUNS;
+
+                printf("    %-7s %zu bodies:   regexec %8.1f us, scanner %8.1f us\n",
+                       locales[l], G_N_ELEMENTS(notification_bodies), regex_us, scanner_us);
+
+                start = g_get_monotonic_time();
+                for (int n = 0; n < N_RUNS / 100; n++)
+                        g_free(test_extract_urls_regex(&regex, body->str));
+                regex_us = (g_get_monotonic_time() - start) / (double) (N_RUNS / 100);
+
+                start = g_get_monotonic_time();
+                for (int n = 0; n < N_RUNS / 100; n++)
+                        g_free(extract_urls(body->str));
+                scanner_us = (g_get_monotonic_time() - start) / (double) (N_RUNS / 100);
+
+                printf("    %-7s %zu KiB body: regexec %8.1f us, scanner %8.1f us\n",
+                       locales[l], body->len / 1024, regex_us, scanner_us);
+
+                regfree(&regex);
+        }
+
+        setlocale(LC_CTYPE, saved_locale);
+        g_free(saved_locale);
+        g_string_free(body, TRUE);
+        PASS();
+}
+
 SUITE(suite_menu)
 {
         RUN_TEST(test_extract_urls_from_empty_string);
@@ -70,5 +255,9 @@ SUITE(suite_menu)
         RUN_TEST(test_extract_urls_from_one_url_port);
         RUN_TEST(test_extract_urls_from_one_url_path);
         RUN_TEST(test_extract_urls_from_one_url_anchor);
+        RUN_TEST(test_extract_urls_parentheses);
+        RUN_TEST(test_extract_urls_word_start);
+        RUN_TEST(test_extract_urls_matches_regex);
+        RUN_TEST(bench_extract_urls);
 }
 /* vim: set tabstop=8 shiftwidth=8 expandtab textwidth=0: */
@@ -150,8 +150,8 @@ TEST test_notification_icon_scaling_toosmall(void)
 {
         struct notification *n = notification_load_icon_with_scaling(20, 100);
 
-        ASSERT_EQ(gdk_pixbuf_get_width(n->icon), 20);
-        ASSERT_EQ(gdk_pixbuf_get_height(n->icon), 20);
+        ASSERT_EQ(cairo_image_surface_get_width(n->icon), 20);
+        ASSERT_EQ(cairo_image_surface_get_height(n->icon), 20);
 
         notification_unref(n);
 
@@ -163,8 +163,8 @@ TEST test_notification_icon_scaling_toolarge(void)
 {
         struct notification *n = notification_load_icon_with_scaling(5, 10);
 
-        ASSERT_EQ(gdk_pixbuf_get_width(n->icon), 10);
-        ASSERT_EQ(gdk_pixbuf_get_height(n->icon), 10);
+        ASSERT_EQ(cairo_image_surface_get_width(n->icon), 10);
+        ASSERT_EQ(cairo_image_surface_get_height(n->icon), 10);
 
         notification_unref(n);
 
@@ -175,8 +175,8 @@ TEST test_notification_icon_scaling_notconfigured(void)
 {
         struct notification *n = notification_load_icon_with_scaling(0, 0);
 
-        ASSERT_EQ(gdk_pixbuf_get_width(n->icon), 16);
-        ASSERT_EQ(gdk_pixbuf_get_height(n->icon), 16);
+        ASSERT_EQ(cairo_image_surface_get_width(n->icon), 16);
+        ASSERT_EQ(cairo_image_surface_get_height(n->icon), 16);
 
         notification_unref(n);
 
@@ -187,14 +187,87 @@ TEST test_notification_icon_scaling_notneeded(void)
 {
         struct notification *n = notification_load_icon_with_scaling(10, 20);
 
-        ASSERT_EQ(gdk_pixbuf_get_width(n->icon), 16);
-        ASSERT_EQ(gdk_pixbuf_get_height(n->icon), 16);
+        ASSERT_EQ(cairo_image_surface_get_width(n->icon), 16);
+        ASSERT_EQ(cairo_image_surface_get_height(n->icon), 16);
 
         notification_unref(n);
 
         PASS();
 }
 
+TEST test_notification_icon_shared(void)
+{
+        char *path = g_strconcat(base, "/data/icons/valid.svg", NULL);
+        GVariant *rawIcon = notification_setup_raw_image(path);
+
+        struct notification *a = notification_create();
+        struct notification *b = notification_create();
+        notification_icon_replace_data(a, rawIcon);
+        notification_icon_replace_data(b, rawIcon);
+
+        ASSERT(a->icon);
+        ASSERT_STR_EQ(a->icon_id, b->icon_id);
+        ASSERTm("Notifications with the same icon have to share the surface",
+                a->icon == b->icon);
+
+        notification_unref(a);
+        notification_unref(b);
+        g_variant_unref(rawIcon);
+        g_free(path);
+
+        PASS();
+}
+
+static guint64 test_icon_lookups(void)
+{
+        struct icon_cache_stats stats = icon_cache_stats_get();
+        return stats.hits + stats.misses;
+}
+
+TEST test_notification_init_loads_icon_once(void)
+{
+        GSList *saved = rules;
+        int cache_size = settings.icon_cache_size;
+        struct rule *r = rule_new();
+
+        r->appname = "mail";
+        r->new_icon = "mail-unread";
+        r->colors.fg = 0x123456FF;
+        r->colors.set = COLOR_FG;
+        rules = g_slist_append(NULL, r);
+        rules_compile();
+        settings.icon_cache_size = 64;
+
+        guint64 before = test_icon_lookups();
+        struct notification *n = notification_create();
+        n->appname = g_strdup("mail");
+        n->iconname = g_strdup("mail-read");
+        notification_init(n);
+
+        ASSERT_EQm("The icon has to get loaded once, after the rules replaced it",
+                   before + 1, test_icon_lookups());
+        ASSERT_STR_EQ("mail-unread", n->iconname);
+        ASSERT_EQ(0x123456FF, n->colors.fg);
+        ASSERTm("Colors not set by a rule have to default to the urgency's colors",
+                n->colors.bg == settings.colors_norm.bg);
+        notification_unref(n);
+
+        before = test_icon_lookups();
+        n = notification_create();
+        n->appname = g_strdup("other");
+        notification_init(n);
+
+        ASSERT_EQ(before + 1, test_icon_lookups());
+        ASSERT_STR_EQ(settings.icons[URG_NORM], n->iconname);
+        notification_unref(n);
+
+        settings.icon_cache_size = cache_size;
+        g_slist_free_full(rules, g_free);
+        rules = saved;
+        rules_teardown();
+        PASS();
+}
+
 TEST test_notification_format_message(struct notification *n, const char *format, const char *exp)
 {
         n->format = format;
@@ -205,6 +278,74 @@ TEST test_notification_format_message(struct notification *n, const char *format
         PASS();
 }
 
+TEST test_notification_format_compiled_once(void)
+{
+        const struct format *fmt = format_get("%a\\n%b");
+
+        ASSERTm("The same format string has to map to the same program",
+                fmt == format_get("%a\\n%b"));
+        ASSERT_EQ(3, fmt->tokens->len);
+        ASSERT_EQ(FORMAT_APPNAME, g_array_index(fmt->tokens, struct format_token, 0).kind);
+        ASSERT_EQ(FORMAT_TEXT,    g_array_index(fmt->tokens, struct format_token, 1).kind);
+        ASSERT_EQ(FORMAT_BODY,    g_array_index(fmt->tokens, struct format_token, 2).kind);
+        ASSERT_STR_EQ("\n", fmt->text->str);
+
+        notification_formats_teardown();
+        PASS();
+}
+
+TEST test_notification_format_ignore_newline(void)
+{
+        struct notification *n = notification_create();
+        int ignore_newline = settings.ignore_newline;
+
+        n->appname = g_strdup("multi\nline <app>");
+        n->format = "%a";
+        settings.ignore_newline = true;
+        notification_format_message(n);
+        ASSERT_STR_EQ("multi line &lt;app&gt;", n->msg);
+
+        settings.ignore_newline = ignore_newline;
+        notification_unref(n);
+        PASS();
+}
+
+TEST test_notification_derived_fields_lazy(void)
+{
+        struct notification *n = notification_create();
+        n->summary = g_strdup("Build failed");
+        n->body = g_strdup("See https://ci.example.com/1234");
+        n->format = "<b>%s</b> %b";
+
+        notification_init(n);
+        ASSERT_FALSE(n->msg);
+        ASSERT_FALSE(n->urls);
+
+        ASSERT_FALSE(notification_msg_is_empty(n));
+        ASSERTm("The literal text of the format proves the message isn't empty", !n->msg);
+
+        ASSERT_STR_EQ("https://ci.example.com/1234", notification_get_urls(n));
+        ASSERT_STR_EQ("<b>Build failed</b> See https://ci.example.com/1234", notification_get_msg(n));
+
+        notification_unref(n);
+        PASS();
+}
+
+TEST test_notification_msg_is_empty(void)
+{
+        struct notification *n = notification_create();
+        n->body = g_strdup("<b> </b>");
+        n->format = "%b";
+        n->markup = MARKUP_STRIP;
+        notification_init(n);
+
+        ASSERTm("Stripping the markup leaves only whitespace", notification_msg_is_empty(n));
+        ASSERT_STR_EQ("", n->msg);
+
+        notification_unref(n);
+        PASS();
+}
+
 TEST test_notification_maxlength(void)
 {
         unsigned int len = 5005;
@@ -237,11 +378,17 @@ SUITE(suite_notification)
 
         RUN_TEST(test_notification_is_duplicate);
         RUN_TEST(test_notification_replace_single_field);
+        RUN_TEST(test_notification_format_compiled_once);
+        RUN_TEST(test_notification_format_ignore_newline);
+        RUN_TEST(test_notification_derived_fields_lazy);
+        RUN_TEST(test_notification_msg_is_empty);
         RUN_TEST(test_notification_referencing);
         RUN_TEST(test_notification_icon_scaling_toosmall);
         RUN_TEST(test_notification_icon_scaling_toolarge);
         RUN_TEST(test_notification_icon_scaling_notconfigured);
         RUN_TEST(test_notification_icon_scaling_notneeded);
+        RUN_TEST(test_notification_icon_shared);
+        RUN_TEST(test_notification_init_loads_icon_once);
 
         // TEST notification_format_message
         struct notification *a = notification_create();
@@ -262,6 +409,9 @@ SUITE(suite_notification)
                 "%%", "%",
                 "%",  "%",
                 "%UNKNOWN", "%UNKNOWN",
+                "%a: %s%%", "MyApp: I&apos;ve got a summary!%",
+                "<b>%s</b>\\n%b\\n", "<b>I&apos;ve got a summary!</b>\nLook at my shiny <notification>",
+                "%z%a%", "%zMyApp%",
                 NULL
         };
 
@@ -385,6 +385,29 @@ TEST test_option_get_bool(void)
         PASS();
 }
 
+TEST test_string_parse_color(void)
+{
+        uint32_t color = 0;
+
+        ASSERT(string_parse_color("#123", &color));
+        ASSERT_EQ(0x112233FF, color);
+        ASSERT(string_parse_color("#1234", &color));
+        ASSERT_EQ(0x11223344, color);
+        ASSERT(string_parse_color("#1793d1", &color));
+        ASSERT_EQ(0x1793D1FF, color);
+        ASSERT(string_parse_color("#1793D180", &color));
+        ASSERT_EQ(0x1793D180, color);
+
+        const char *invalid[] = { "", "#", "123456", "#12", "#12345", "#123456789", "#12345g", " #123" };
+        for (int i = 0; i < G_N_ELEMENTS(invalid); i++) {
+                color = 0;
+                ASSERT_FALSEm(invalid[i], string_parse_color(invalid[i], &color));
+                ASSERT_EQ(0, color);
+        }
+
+        PASS();
+}
+
 SUITE(suite_option_parser)
 {
         char *config_path = g_strconcat(base, "/data/test-ini", NULL);
@@ -426,6 +449,7 @@ SUITE(suite_option_parser)
         RUN_TEST(test_option_get_int);
         RUN_TEST(test_option_get_double);
         RUN_TEST(test_option_get_bool);
+        RUN_TEST(test_string_parse_color);
 
         g_free(config_path);
         free_ini();
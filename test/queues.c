@@ -425,6 +425,34 @@ TEST test_datachange_ttl(void)
         PASS();
 }
 
+TEST test_datachange_ttl_after_close_and_replace(void)
+{
+        struct notification *n1, *n2, *n3;
+        settings.show_age_threshold = -1;
+        queues_init();
+
+        n1 = test_notification("n1", 15);
+        n2 = test_notification("n2", 10);
+
+        queues_notification_insert(n1);
+        queues_notification_insert(n2);
+        queues_update(STATUS_NORMAL);
+
+        queues_notification_close(n2, REASON_UNDEF);
+        ASSERT_IN_RANGEm("The closed notification must not be used as sleep time anymore.",
+               n1->timeout - S2US(1), queues_get_next_datachange(time_monotonic_now()), S2US(1));
+
+        n1->start -= S2US(10);
+        n3 = test_notification("n3", 15);
+        n3->id = n1->id;
+        queues_notification_insert(n3);
+        ASSERT_IN_RANGEm("The replacing notification has to get displayed for its full timeout.",
+               n3->timeout - S2US(1), queues_get_next_datachange(time_monotonic_now()), S2US(1));
+
+        queues_teardown();
+        PASS();
+}
+
 TEST test_queue_stacking(void)
 {
         settings.stack_duplicates = true;
@@ -484,6 +512,98 @@ TEST test_queue_stacktag(void)
         PASS();
 }
 
+TEST test_queue_stacktag_skips_derived_fields(void)
+{
+        struct notification *n1, *n2;
+
+        queues_init();
+
+        n1 = test_notification("n1", 1);
+        n2 = test_notification("n2", 1);
+        n1->body = string_append(n1->body, "https://example.com", " ");
+        n1->stack_tag = g_strdup("volume");
+        n2->stack_tag = g_strdup("volume");
+
+        queues_notification_insert(n1);
+        notification_ref(n1);
+        queues_notification_insert(n2);
+
+        ASSERTm("A stacked away notification must not get formatted", !n1->msg);
+        ASSERTm("A stacked away notification must not get scanned for urls", !n1->urls);
+        NOT_LAST(n1);
+
+        queues_teardown();
+        PASS();
+}
+
+TEST test_queue_stacktag_after_replace(void)
+{
+        const char *stacktag = "stacktag";
+        struct notification *n1, *n2, *n3;
+
+        queues_init();
+
+        n1 = test_notification("n1", -1);
+        n2 = test_notification("n2", -1);
+        n3 = test_notification("n3", -1);
+        n1->stack_tag = g_strdup(stacktag);
+        n2->stack_tag = g_strdup(stacktag);
+        n3->stack_tag = g_strdup(stacktag);
+
+        queues_notification_insert(n1);
+        queues_update(STATUS_NORMAL);
+        QUEUE_LEN_ALL(0, 1, 0);
+
+        n2->id = n1->id;
+        notification_ref(n2);
+        queues_notification_insert(n2);
+        QUEUE_CONTAINS(DISP, n2);
+
+        queues_notification_insert(n3);
+        QUEUE_LEN_ALL(0, 1, 0);
+        QUEUE_CONTAINS(DISP, n3);
+        NOT_LAST(n2);
+
+        queues_notification_close(n3, REASON_UNDEF);
+        n1 = test_notification("n1", -1);
+        n1->stack_tag = g_strdup(stacktag);
+        queues_notification_insert(n1);
+        QUEUE_LEN_ALL(1, 0, 1);
+
+        queues_teardown();
+        PASS();
+}
+
+TEST test_queue_waiting_sorted(void)
+{
+        settings.sort = true;
+        settings.history_length = 0;
+        queues_init();
+
+        enum urgency urgencies[] = { URG_LOW, URG_CRIT, URG_NORM, URG_LOW, URG_CRIT, URG_NORM, URG_NORM };
+        struct notification *n;
+
+        for (int i = 0; i < G_N_ELEMENTS(urgencies); i++) {
+                char name[] = { 'n', '0'+i, '\0' }; // n<i>
+                n = test_notification(name, -1);
+                n->urgency = urgencies[i];
+                queues_notification_insert(n);
+                if (i % 2 == 0)
+                        queues_notification_close(n, REASON_UNDEF);
+        }
+
+        for (int i = 0; i < G_N_ELEMENTS(urgencies) / 2 + 1; i++)
+                queues_history_pop();
+
+        QUEUE_LEN_ALL(G_N_ELEMENTS(urgencies), 0, 0);
+
+        for (GList *iter = g_queue_peek_head_link(waiting); iter && iter->next; iter = iter->next)
+                ASSERT(notification_cmp(iter->data, iter->next->data) < 0);
+
+        queues_teardown();
+        PASS();
+}
+
 TEST test_queue_timeout(void)
 {
         settings.geometry.h = 5;
@@ -511,6 +631,15 @@ TEST test_queue_timeout(void)
         QUEUE_LEN_ALL(0,2,1);
         QUEUE_CONTAINS(HIST, n3);
 
+        // the timeout restarts, once the user is back
+        n1->start -= S2US(11);
+        n2->start -= S2US(11);
+        queues_update(STATUS_IDLE);
+        queues_update(STATUS_NORMAL);
+
+        QUEUE_LEN_ALL(0,2,1);
+        ASSERT(queues_get_next_datachange(time_monotonic_now()) > S2US(9));
+
         // hacky way to shift time
         n1->start -= S2US(11);
         n2->start -= S2US(11);
@@ -763,6 +892,129 @@ TEST test_queue_find_by_id(void)
         PASS();
 }
 
+TEST test_queue_find_by_id_across_queues(void)
+{
+        settings.history_length = 2;
+        settings.geometry.h = 0;
+        queues_init();
+
+        struct notification *n = test_notification("n", -1);
+        struct notification *evicted = test_notification("evicted", -1);
+        queues_notification_insert(evicted);
+        queues_notification_insert(n);
+        int id = n->id;
+        int evicted_id = evicted->id;
+
+        ASSERT(queues_get_by_id(id) == n);
+        queues_update(STATUS_NORMAL);
+        QUEUE_CONTAINS(DISP, n);
+        ASSERT(queues_get_by_id(id) == n);
+
+        queues_notification_close(evicted, REASON_UNDEF);
+        queues_notification_close(n, REASON_UNDEF);
+        QUEUE_CONTAINS(HIST, n);
+        ASSERT(queues_get_by_id(id) == n);
+
+        queues_history_pop();
+        QUEUE_CONTAINS(WAIT, n);
+        ASSERT(queues_get_by_id(id) == n);
+
+        queues_notification_close_id(id, REASON_UNDEF);
+        struct notification *n2 = test_notification("n2", -1);
+        queues_notification_insert(n2);
+        queues_notification_close(n2, REASON_UNDEF);
+
+        QUEUE_LEN_ALL(0, 0, 2);
+        ASSERT(queues_get_by_id(evicted_id) == NULL);
+        ASSERT(queues_get_by_id(id) == n);
+        ASSERT(queues_get_by_id(n2->id) == n2);
+
+        queues_teardown();
+        PASS();
+}
+
+TEST test_queue_replace_id_urgency(void)
+{
+        settings.geometry.h = 1;
+        queues_init();
+
+        struct notification *shown = test_notification("shown", -1);
+        struct notification *queued = test_notification("queued", -1);
+        queues_notification_insert(shown);
+        queues_notification_insert(queued);
+        queues_update(STATUS_NORMAL);
+        QUEUE_CONTAINS(DISP, shown);
+        QUEUE_CONTAINS(WAIT, queued);
+
+        struct notification *n = test_notification("shown again", -1);
+        n->id = shown->id;
+        n->urgency = URG_CRIT;
+        ASSERT(queues_notification_replace_id(n));
+        QUEUE_LEN_ALL(1, 1, 0);
+        QUEUE_CONTAINS(DISP, n);
+        ASSERT(queues_get_by_id(n->id) == n);
+        ASSERTm("A displayed replacement has to start its timeout", n->start > 0);
+
+        n = test_notification("queued again", -1);
+        n->id = queued->id;
+        n->urgency = URG_LOW;
+        ASSERT(queues_notification_replace_id(n));
+        QUEUE_LEN_ALL(1, 1, 0);
+        QUEUE_CONTAINS(WAIT, n);
+        ASSERT(queues_get_by_id(n->id) == n);
+        ASSERTm("A waiting replacement must not start its timeout", n->start == 0);
+
+        queues_teardown();
+        PASS();
+}
+
+TEST test_queue_find_by_id_history_and_live(void)
+{
+        settings.geometry.h = 0;
+        queues_init();
+
+        struct notification *old = test_notification("old", -1);
+        queues_notification_insert(old);
+        int id = old->id;
+        queues_notification_close(old, REASON_UNDEF);
+        QUEUE_CONTAINS(HIST, old);
+
+        struct notification *live = test_notification("live", -1);
+        live->id = id;
+        queues_notification_insert(live);
+        QUEUE_CONTAINS(WAIT, live);
+        ASSERT(queues_get_by_id(id) == live);
+
+        /* The notification in history has to be found again */
+        live->history_ignore = true;
+        queues_notification_close(live, REASON_UNDEF);
+        QUEUE_LEN_ALL(0, 0, 1);
+        ASSERT(queues_get_by_id(id) == old);
+
+        /* Of multiple notifications in history, the first one is found */
+        struct notification *again = test_notification("again", -1);
+        again->id = id;
+        queues_notification_insert(again);
+        queues_notification_close(again, REASON_UNDEF);
+        QUEUE_LEN_ALL(0, 0, 2);
+        ASSERT(queues_get_by_id(id) == old);
+
+        queues_history_pop();
+        QUEUE_CONTAINS(WAIT, again);
+        ASSERT(queues_get_by_id(id) == again);
+
+        /* Leaving history points the id to the remaining one */
+        again->history_ignore = true;
+        queues_notification_close(again, REASON_UNDEF);
+        ASSERT(queues_get_by_id(id) == old);
+        queues_history_pop();
+        ASSERT(queues_get_by_id(id) == old);
+        QUEUE_CONTAINS(WAIT, old);
+
+        queues_teardown();
+        PASS();
+}
+
 SUITE(suite_queues)
 {
         settings.icon_path = "";
@@ -772,6 +1024,7 @@ SUITE(suite_queues)
         RUN_TEST(test_datachange_endless_agethreshold);
         RUN_TEST(test_datachange_queues);
         RUN_TEST(test_datachange_ttl);
+        RUN_TEST(test_datachange_ttl_after_close_and_replace);
         RUN_TEST(test_queue_history_overfull);
         RUN_TEST(test_queue_history_pushall);
         RUN_TEST(test_queue_init);
@@ -785,7 +1038,10 @@ SUITE(suite_queues)
         RUN_TEST(test_queue_notification_skip_display_redisplayed);
         RUN_TEST(test_queue_stacking);
         RUN_TEST(test_queue_stacktag);
+        RUN_TEST(test_queue_stacktag_after_replace);
+        RUN_TEST(test_queue_stacktag_skips_derived_fields);
         RUN_TEST(test_queue_teardown);
+        RUN_TEST(test_queue_waiting_sorted);
         RUN_TEST(test_queue_timeout);
         RUN_TEST(test_queues_update_fullscreen);
         RUN_TEST(test_queues_update_paused);
@@ -794,6 +1050,9 @@ SUITE(suite_queues)
         RUN_TEST(test_queues_update_xmore);
         RUN_TEST(test_queues_timeout_before_paused);
         RUN_TEST(test_queue_find_by_id);
+        RUN_TEST(test_queue_find_by_id_across_queues);
+        RUN_TEST(test_queue_find_by_id_history_and_live);
+        RUN_TEST(test_queue_replace_id_urgency);
 
         settings.icon_path = NULL;
 }
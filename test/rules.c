@@ -0,0 +1,359 @@
+#include "../src/rules.c"
+
+#include "greatest.h"
+
+#include <glib.h>
+
+/* Use the script of a rule as its name to check the order of
+ * applied rules via n->scripts */
+static struct rule *test_rule_new(const char *script)
+{
+        struct rule *r = rule_new();
+        r->script = script;
+        return r;
+}
+
+static void test_rules_free(GSList *list)
+{
+        g_slist_free_full(list, g_free);
+}
+
+static char *test_applied_rules(struct notification *n)
+{
+        GString *applied = g_string_new(NULL);
+        for (int i = 0; i < n->script_count; i++)
+                g_string_append(applied, n->scripts[i]);
+        return g_string_free(applied, FALSE);
+}
+
+TEST test_rule_pattern_is_literal(void)
+{
+        ASSERT(rule_pattern_is_literal("firefox"));
+        ASSERT(rule_pattern_is_literal("im.received"));
+        ASSERT_FALSE(rule_pattern_is_literal("fire*"));
+        ASSERT_FALSE(rule_pattern_is_literal("fire?ox"));
+        ASSERT_FALSE(rule_pattern_is_literal("[fF]irefox"));
+        ASSERT_FALSE(rule_pattern_is_literal("fire\\fox"));
+        PASS();
+}
+
+TEST test_rules_compile_buckets(void)
+{
+        GSList *saved = rules;
+        struct rule *literal = test_rule_new("a");
+        struct rule *glob = test_rule_new("b");
+        struct rule *both = test_rule_new("c");
+
+        literal->category = "email";
+        glob->appname = "mail*";
+        both->appname = "mail*";
+        both->desktop_entry = "thunderbird";
+
+        rules = NULL;
+        rules = g_slist_append(rules, literal);
+        rules = g_slist_append(rules, glob);
+        rules = g_slist_append(rules, both);
+        rules_compile();
+
+        GArray *bucket = g_hash_table_lookup(rule_index->literals[RULE_INDEX_CATEGORY], "email");
+        ASSERT(bucket);
+        ASSERT_EQ(1, bucket->len);
+        ASSERT_EQ(0, g_array_index(bucket, guint, 0));
+
+        bucket = g_hash_table_lookup(rule_index->literals[RULE_INDEX_DESKTOP_ENTRY], "thunderbird");
+        ASSERT(bucket);
+        ASSERT_EQ(2, g_array_index(bucket, guint, 0));
+
+        ASSERT_EQ(1, rule_index->others->len);
+        ASSERT_EQ(1, g_array_index(rule_index->others, guint, 0));
+
+        test_rules_free(rules);
+        rules = saved;
+        rules_teardown();
+        PASS();
+}
+
+TEST test_rule_apply_all_keeps_order(void)
+{
+        GSList *saved = rules;
+        const char *scripts[] = { "1", "2", "3", "4", "5" };
+        struct rule *r[G_N_ELEMENTS(scripts)];
+
+        rules = NULL;
+        for (int i = 0; i < G_N_ELEMENTS(scripts); i++) {
+                r[i] = test_rule_new(scripts[i]);
+                rules = g_slist_append(rules, r[i]);
+        }
+        r[0]->category = "im.received";
+        r[1]->appname = "chat*";
+        r[2]->appname = "chat";
+        r[3]->appname = "other";
+        r[4]->desktop_entry = "chat";
+        r[4]->summary = "hello*";
+        rules_compile();
+
+        struct notification *n = notification_create();
+        n->appname = g_strdup("chat");
+        n->category = g_strdup("im.received");
+        n->desktop_entry = g_strdup("chat");
+        n->summary = g_strdup("hello world");
+
+        rule_apply_all(n);
+
+        char *applied = test_applied_rules(n);
+        ASSERT_STR_EQ("1235", applied);
+        g_free(applied);
+
+        notification_unref(n);
+        test_rules_free(rules);
+        rules = saved;
+        rules_teardown();
+        PASS();
+}
+
+TEST test_rule_apply_all_new_stack_tag(void)
+{
+        GSList *saved = rules;
+        struct rule *before = test_rule_new("1");
+        struct rule *set = test_rule_new("2");
+        struct rule *after = test_rule_new("3");
+
+        before->stack_tag = "volume";
+        set->appname = "pamixer";
+        set->set_stack_tag = "volume";
+        after->stack_tag = "volume";
+
+        rules = NULL;
+        rules = g_slist_append(rules, before);
+        rules = g_slist_append(rules, set);
+        rules = g_slist_append(rules, after);
+        rules_compile();
+
+        struct notification *n = notification_create();
+        n->appname = g_strdup("pamixer");
+
+        rule_apply_all(n);
+
+        char *applied = test_applied_rules(n);
+        ASSERT_STR_EQm("Only rules after the rule setting the stack tag may match it", "23", applied);
+        g_free(applied);
+
+        notification_unref(n);
+        test_rules_free(rules);
+        rules = saved;
+        rules_teardown();
+        PASS();
+}
+
+TEST test_rule_apply_all_new_urgency(void)
+{
+        GSList *saved = rules;
+        struct rule *critical_before = test_rule_new("1");
+        struct rule *escalate = test_rule_new("2");
+        struct rule *critical_after = test_rule_new("3");
+
+        critical_before->msg_urgency = URG_CRIT;
+        escalate->appname = "backup";
+        escalate->urgency = URG_CRIT;
+        critical_after->msg_urgency = URG_CRIT;
+
+        rules = NULL;
+        rules = g_slist_append(rules, critical_before);
+        rules = g_slist_append(rules, escalate);
+        rules = g_slist_append(rules, critical_after);
+        rules_compile();
+
+        struct notification *n = notification_create();
+        n->appname = g_strdup("backup");
+        n->urgency = URG_NORM;
+
+        rule_apply_all(n);
+
+        char *applied = test_applied_rules(n);
+        ASSERT_STR_EQm("Only rules after the rule changing the urgency may match it", "23", applied);
+        g_free(applied);
+
+        notification_unref(n);
+        test_rules_free(rules);
+        rules = saved;
+        rules_teardown();
+        PASS();
+}
+
+TEST test_rule_cache_hit(void)
+{
+        GSList *saved = rules;
+        struct rule *app = test_rule_new("1");
+        struct rule *summary = test_rule_new("2");
+
+        app->appname = "mail";
+        summary->appname = "mail";
+        summary->summary = "urgent*";
+
+        rules = NULL;
+        rules = g_slist_append(rules, app);
+        rules = g_slist_append(rules, summary);
+        rules_compile();
+
+        struct rule_cache_stats before = rule_cache_stats_get();
+        const char *summaries[] = { "hello", "urgent: hello" };
+        const char *expected[] = { "1", "12" };
+
+        for (int i = 0; i < G_N_ELEMENTS(summaries); i++) {
+                struct notification *n = notification_create();
+                n->appname = g_strdup("mail");
+                n->summary = g_strdup(summaries[i]);
+
+                rule_apply_all(n);
+
+                char *applied = test_applied_rules(n);
+                ASSERTm("The message filters have to be checked per notification",
+                        STR_EQ(expected[i], applied));
+                g_free(applied);
+                notification_unref(n);
+        }
+
+        struct rule_cache_stats after = rule_cache_stats_get();
+        ASSERT_EQ(before.misses + 1, after.misses);
+        ASSERT_EQ(before.hits + 1, after.hits);
+
+        /* Compiling the rules again has to drop the cached matches */
+        app->appname = "other";
+        rules_compile();
+        struct notification *n = notification_create();
+        n->appname = g_strdup("mail");
+        rule_apply_all(n);
+        ASSERT_EQ(0, n->script_count);
+        ASSERT_EQ(after.misses + 1, rule_cache_stats_get().misses);
+        notification_unref(n);
+
+        test_rules_free(rules);
+        rules = saved;
+        rules_teardown();
+        PASS();
+}
+
+TEST test_rule_apply_all_other_stack_tag(void)
+{
+        GSList *saved = rules;
+        struct rule *volume = test_rule_new("1");
+        struct rule *brightness = test_rule_new("2");
+
+        volume->stack_tag = "volume";
+        brightness->stack_tag = "brightness";
+
+        rules = NULL;
+        rules = g_slist_append(rules, volume);
+        rules = g_slist_append(rules, brightness);
+        rules_compile();
+
+        struct notification *n = notification_create();
+        n->stack_tag = g_strdup("volume");
+        rule_apply_all(n);
+
+        char *applied = test_applied_rules(n);
+        ASSERT_STR_EQ("1", applied);
+        g_free(applied);
+        ASSERTm("Rules with another stack tag must not get checked",
+                brightness->stats.checks == 0);
+
+        notification_unref(n);
+        test_rules_free(rules);
+        rules = saved;
+        rules_teardown();
+        PASS();
+}
+
+TEST test_rule_cache_evicts_least_recently_used(void)
+{
+        GSList *saved = rules;
+        rules = NULL;
+        rules_compile();
+
+        /* Fill the cache, the signature of app0 is the oldest */
+        for (int i = 0; i <= RULE_CACHE_SIZE; i++) {
+                struct notification *n = notification_create();
+                n->appname = g_strdup_printf("app%d", i % RULE_CACHE_SIZE);
+                rule_apply_all(n);
+                notification_unref(n);
+        }
+
+        /* Adding another signature has to evict app1 instead of app0 */
+        struct notification *n = notification_create();
+        n->appname = g_strdup("another");
+        rule_apply_all(n);
+        notification_unref(n);
+
+        const char *appnames[] = { "app0", "app1" };
+        const bool cached[] = { true, false };
+        for (int i = 0; i < G_N_ELEMENTS(appnames); i++) {
+                struct rule_cache_stats before = rule_cache_stats_get();
+                n = notification_create();
+                n->appname = g_strdup(appnames[i]);
+                rule_apply_all(n);
+                notification_unref(n);
+                ASSERT_EQ(cached[i], rule_cache_stats_get().hits == before.hits + 1);
+        }
+
+        rules = saved;
+        rules_teardown();
+        PASS();
+}
+
+TEST test_rule_stats(void)
+{
+        GSList *saved = rules;
+        struct rule *app = test_rule_new("1");
+        struct rule *summary = test_rule_new("2");
+        struct rule *other = test_rule_new("3");
+
+        app->appname = "mail";
+        summary->appname = "mail";
+        summary->summary = "urgent*";
+        other->appname = "other";
+
+        rules = NULL;
+        rules = g_slist_append(rules, app);
+        rules = g_slist_append(rules, summary);
+        rules = g_slist_append(rules, other);
+        rules_compile();
+
+        const char *summaries[] = { "hello", "urgent: hello", "urgent: bye" };
+        for (int i = 0; i < G_N_ELEMENTS(summaries); i++) {
+                struct notification *n = notification_create();
+                n->appname = g_strdup("mail");
+                n->summary = g_strdup(summaries[i]);
+                rule_apply_all(n);
+                notification_unref(n);
+        }
+
+        ASSERT_EQ(3, app->stats.checks);
+        ASSERT_EQ(3, app->stats.matches);
+        ASSERT_EQ(3, app->stats.applies);
+
+        ASSERT_EQ(3, summary->stats.checks);
+        ASSERT_EQ(2, summary->stats.matches);
+        ASSERT_EQ(2, summary->stats.applies);
+
+        ASSERTm("Rules not matching the signature must not get checked",
+                other->stats.checks == 0 && other->stats.applies == 0);
+
+        test_rules_free(rules);
+        rules = saved;
+        rules_teardown();
+        PASS();
+}
+
+SUITE(suite_rules)
+{
+        RUN_TEST(test_rule_pattern_is_literal);
+        RUN_TEST(test_rules_compile_buckets);
+        RUN_TEST(test_rule_apply_all_keeps_order);
+        RUN_TEST(test_rule_apply_all_new_stack_tag);
+        RUN_TEST(test_rule_apply_all_new_urgency);
+        RUN_TEST(test_rule_apply_all_other_stack_tag);
+        RUN_TEST(test_rule_cache_hit);
+        RUN_TEST(test_rule_cache_evicts_least_recently_used);
+        RUN_TEST(test_rule_stats);
+}
+/* vim: set tabstop=8 shiftwidth=8 expandtab textwidth=0: */
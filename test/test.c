@@ -15,7 +15,9 @@ SUITE_EXTERN(suite_notification);
 SUITE_EXTERN(suite_markup);
 SUITE_EXTERN(suite_misc);
 SUITE_EXTERN(suite_icon);
+SUITE_EXTERN(suite_icon_theme);
 SUITE_EXTERN(suite_queues);
+SUITE_EXTERN(suite_rules);
 SUITE_EXTERN(suite_dunst);
 SUITE_EXTERN(suite_log);
 SUITE_EXTERN(suite_menu);
@@ -44,7 +46,9 @@ int main(int argc, char *argv[]) {
         RUN_SUITE(suite_markup);
         RUN_SUITE(suite_misc);
         RUN_SUITE(suite_icon);
+        RUN_SUITE(suite_icon_theme);
         RUN_SUITE(suite_queues);
+        RUN_SUITE(suite_rules);
         RUN_SUITE(suite_dunst);
         RUN_SUITE(suite_log);
         RUN_SUITE(suite_menu);